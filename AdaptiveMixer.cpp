@@ -6,16 +6,30 @@
 #include "UObject/ConstructorHelpers.h" 
 #include "AudioDevice.h"
 #include "ActiveSound.h"
+#include "Templates/UnrealTemplate.h"
+#include "Net/UnrealNetwork.h"
+#include "Sound/SoundNodeWavePlayer.h"
+#include "AudioThread.h"
 
 
 DEFINE_LOG_CATEGORY(AdaptiveMixerLog);
 #define print_debug_message(text) if (GEngine) GEngine->AddOnScreenDebugMessage(-1, 1.5, FColor::Red,text)
+
+constexpr float RESTORE_FADE_TIME = 0.1f;
+constexpr float LAYER_PHASE_TOLERANCE = 0.02f; // seconds a playing layer may be off the transport.
+
+// control log codes (SetFadeEngine curve, RestoreSnapshot filter operation):
+static const TCHAR* LOGGED_FADE_CURVES[] = { TEXT("linear"), TEXT("equal_power"), TEXT("s_curve"), TEXT("custom") };
+static const TCHAR* LOGGED_FILTER_OPERATIONS[] = { TEXT("or"), TEXT("and"), TEXT("xor") };
     
 
 AAdaptiveMixer::AAdaptiveMixer() {
     
     UE_LOG(AdaptiveMixerLog, Display, TEXT("Adaptive mixer created."));
     
+    PrimaryActorTick.bCanEverTick = true;           // only to complete awaited transitions,
+    PrimaryActorTick.bStartWithTickEnabled = false; // see __awaitTransition.
+    
     for (int i = 0; i < PTRN_COUNT; ++i) {
         __pattern_audio_components[i] = CreateDefaultSubobject<UAudioComponent>
             (*FString("pattern_audiocomp" + FString::FromInt(i)));
@@ -49,10 +63,16 @@ AAdaptiveMixer::AAdaptiveMixer() {
         
     __default_adaptive_score = CreateDefaultSubobject<UAdaptiveScore>(TEXT("default_adaptive_score"));
     __default_dynamic_filter_chain = CreateDefaultSubobject<UDynamicFilterChain>(TEXT("default_dfc"));  
+    __default_intensity_vector = CreateDefaultSubobject<UIntensityVector>(TEXT("default_intensity_vector"));
+    __default_texture_rule_set = CreateDefaultSubobject<UTextureRuleSet>(TEXT("default_texture_rule_set"));
+    __default_texture_arbiter = CreateDefaultSubobject<UTextureArbiter>(TEXT("default_texture_arbiter"));
     
     if ((count == __all_audio_components.Num()) &&
     (__default_adaptive_score != nullptr) &&
-    (__default_dynamic_filter_chain != nullptr)) {
+    (__default_dynamic_filter_chain != nullptr) &&
+    (__default_intensity_vector != nullptr) &&
+    (__default_texture_rule_set != nullptr) &&
+    (__default_texture_arbiter != nullptr)) {
         UE_LOG(AdaptiveMixerLog, Display, TEXT("Adaptive mixer: subobject creation successful."));
     }
     else {
@@ -62,6 +82,50 @@ AAdaptiveMixer::AAdaptiveMixer() {
     __is_running = false;
     __is_initialized = false;
     __texture = 0;
+    __processed_texture = 0;
+    __intensity_mode = false;
+    __intensity_smoothing_time = 0.1f;
+    __control_nested = false;
+    __fade_engine_enabled = false;
+    __fade_engine_stems = 0;
+    __budget_dropped = 0;
+    __cues_evicted = false;
+    __gains_settled = false;
+    __bridge_pending = false;
+    __bridge_index = -1;
+    __bridge_volume = 1.0f;
+    __bridge_start_time = 0.0f;
+    __bridge_crossfade_time = 0.0f;
+    __transport_start_time = 0.0f;
+    __pattern_length = 0.0f;
+    __bar_length = 0.0f;
+    __ducking_submix = nullptr;
+    __ducking_active = false;
+    __rep_texture = 0;
+    __rep_server_audio_time = 0.0f;
+    __server_clock_offset = 0.0f;
+    __server_clock_valid = false;
+    __applying_replication = false;
+    __listener_set_count = 0;
+    __latency_token = 0;
+    __latency_on_render = false;
+    __latency_on_audio_thread = false;
+    __run_latency_token = 0;
+    __bridge_latency_token = 0;
+    __stinger_latency_token = 0;
+    __prepared = false;
+    __start_requested_time = 0.0;
+    __start_probe_percent = -1.0f;
+    __bridge_requested_time = 0.0;
+    __start_latency = -1.0f;
+    __bridge_start_latency = -1.0f;
+    __run_serial = 0;
+    __bridge_serial = 0;
+    __stinger_serial = 0;
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        __applied_gains[i] = 0.0f;
+        __container_waves[i] = nullptr;
+    }
 }
 
 
@@ -91,12 +155,24 @@ bool AAdaptiveMixer::InitializeMixer(UAdaptiveScore* adaptive_composition, float
         return false;
     }
     
+    __discardPreroll();
     __is_initialized = false;
     
+    FStemCache::Get().Register(this, nullptr); // drops the previous score.
+    FStemCache::Get().Load(adaptive_composition); // evicted cues come back here.
+    __cues_evicted = false;
     __loaded_score = adaptive_composition;
     TArray<USoundCue*> patterns = __loaded_score->GetPatternCues();
     
-    if (patterns.Num() < 1) {
+    TSharedPtr<FStemContainerReader, ESPMode::ThreadSafe> container;
+    FString container_path = __loaded_score->GetStemContainer();
+    if (!container_path.IsEmpty()) {
+        container = FStemContainerReader::Open(container_path);
+        if (!container.IsValid())
+            UE_LOG(AdaptiveMixerLog, Warning, TEXT("Can't open stem container %s, using the pattern cues."), *container_path);
+    }
+    
+    if ((patterns.Num() < 1) && !container.IsValid()) {
         UE_LOG(AdaptiveMixerLog, Warning, TEXT("Patterns array is empty. Initialization canceled."));
         return false;
     }
@@ -106,14 +182,24 @@ bool AAdaptiveMixer::InitializeMixer(UAdaptiveScore* adaptive_composition, float
     initialized_patterns = 0;
     
     for (int i = 0; i < PTRN_COUNT; ++i) {
-        USoundCue* loadCue = i < patterns.Num() ? patterns[i] : nullptr;
-        bool validCue = __isSoundBaseValid(loadCue);
+        USoundBase* loadSound = i < patterns.Num() ? patterns[i] : nullptr;
+        __container_waves[i] = nullptr;
+        if (container.IsValid()) {
+            loadSound = nullptr;
+            if ((i < int(container->GetStemCount())) && container->IsStemPresent(i)) {
+                __container_waves[i] = NewObject<UStemContainerWave>(this);
+                __container_waves[i]->Initialize(container, i);
+                loadSound = __container_waves[i];
+            }
+        }
+        bool validCue = __isSoundBaseValid(loadSound);
         if (validCue) {
-            __pattern_audio_components[i]->SetSound(loadCue);
+            __pattern_audio_components[i]->SetSound(loadSound);
             ++initialized_patterns;
             UE_LOG(AdaptiveMixerLog, Display, TEXT("Pattern %d cue initialized."), i);
         }
         __patterns_validation[i] = validCue ? TRUE : FALSE;
+        __pattern_priorities[i] = __loaded_score->GetPatternPriority(i);
     }
     
     if (initialized_patterns < 1) {
@@ -124,12 +210,16 @@ bool AAdaptiveMixer::InitializeMixer(UAdaptiveScore* adaptive_composition, float
     
     //it's ok:
     __is_initialized = true;
+    FStemCache::Get().Register(this, __loaded_score);
     __bridge_sound_cues = __loaded_score->GetBridgeCues();
     __stinger_sound_cues = __loaded_score->GetStingerCues();
     __initializeDefaultVolume();
     __master_volume = master_volume;
     __score_fade_time = __loaded_score->GetFadeTime();
     __score_filterchain_index = __loaded_score->GetFilterchainIndex();
+    __pattern_length = container.IsValid() ? container->GetDuration() : __loaded_score->GetLoopLength();
+    __routeDuckingSends();
+    __routeFadeEngine(); // the new cues may or may not carry the gain source.
     __default_dynamic_filter_chain->Clear();
     UE_LOG(AdaptiveMixerLog, Display, TEXT("Adaptive mixer initialized."));
     return true;
@@ -137,6 +227,12 @@ bool AAdaptiveMixer::InitializeMixer(UAdaptiveScore* adaptive_composition, float
 
 void AAdaptiveMixer::Run(uint8 initial_texture) {
     
+    if (__ignoresLocalControl())
+        return;
+    
+    __recordControl(EMixerControlOp::Run, { float(initial_texture) });
+    TGuardValue<bool> nested_guard(__control_nested, true);
+    
     if (!__is_initialized) {
         UE_LOG(AdaptiveMixerLog, Warning, TEXT("Adaptive mixer is not initialized."));
         return;
@@ -146,25 +242,57 @@ void AAdaptiveMixer::Run(uint8 initial_texture) {
         Stop();
     }
     
+    __start_requested_time = FPlatformTime::Seconds();
+    __start_probe_percent = __prepared ? FMath::Max(__start_probe_percent, 0.0f) : -1.0f; // held at 0 by Prepare.
+    if (!__prepared) {
+        __acquireCues();
+        __optimizeFilterChains();
+        __armStartProbe();
+    }
+    __beginLatency(EControlLatencyEvent::Run);
     __is_running = true;
+    __startDucking();
     __beginToPlaySilently();
     __texture = initial_texture;
     __decodeFromByte(__getFilteredTexture(), __score_fade_time);
+    __endLatency(&__run_latency_token);
+    ++__run_serial;
     UE_LOG(AdaptiveMixerLog, Display, TEXT("Adaptive mixer is running."));
 }
 
 void AAdaptiveMixer::Stop() {
     
-    if (!__is_running)
+    if (__ignoresLocalControl())
+        return;
+    
+    __recordControl(EMixerControlOp::Stop, {});
+    
+    if (!__is_running) {
+        __discardPreroll();
         return;
+    }
     
     __is_running = false;
+    __cancelTransitions();
     
     for (int i = 0; i < PTRN_COUNT; ++i) {
         if (__patterns_validation[i] == TRUE) {
             __pattern_audio_components[i]->Stop();
         }
     }
+    FStemVoiceBudget::Get().Release(this);
+    FStemCache::Get().Release(this);
+    __stopDucking();
+    FFilterChainProfiler::Get().EndTexture(this, GetWorld()->GetTimeSeconds());
+    
+    // changes waiting for a bar still land, the layers start again with Run:
+    GetWorld()->GetTimerManager().ClearTimer(__layer_bar_timer_handle);
+    GetWorld()->GetTimerManager().ClearTimer(__layer_realign_timer_handle);
+    for (UScoreLayer* layer : __layers) {
+        __applyLayerChange(layer);
+        if (layer->IsPlaying())
+            layer->Stop(0.0f);
+    }
     
     UE_LOG(AdaptiveMixerLog, Display, TEXT("Adaptive mixer stoped."));  
 }
@@ -191,20 +319,34 @@ void AAdaptiveMixer::DecreaseTexture() {
 
 void AAdaptiveMixer::PlayNewTexture(uint8 new_texture) {
     
+    if (__ignoresLocalControl())
+        return;
+    
+    __recordControl(EMixerControlOp::PlayNewTexture, { float(new_texture) });
+    
     if (!__is_running)
         return;
     
     if (__texture != new_texture) {
+        uint8 previous_texture = __texture;
         __texture = new_texture;
-        uint8 processed_txt = __getFilteredTexture();
-        __decodeFromByte(processed_txt, __score_fade_time);
+        __beginLatency(EControlLatencyEvent::Texture);
+        if (!__playTransitionPlan(previous_texture, new_texture))
+            __decodeFromByte(__getFilteredTexture(), __score_fade_time);
+        __endLatency();
         UE_LOG(AdaptiveMixerLog, Display, TEXT("__texture changed to %d"), __texture);
-        UE_LOG(AdaptiveMixerLog, Display, TEXT("(processed is %d)"), processed_txt);
+        UE_LOG(AdaptiveMixerLog, Display, TEXT("(processed is %d)"), __processed_texture);
     }
 }
 
 void AAdaptiveMixer::PlayNewTextureAfterBridge(uint8 new_texture, int bridge_index,
     float fade_out_ratio, float fade_in_ratio, float bridge_volume) {
+    
+    if (__ignoresLocalControl())
+        return;
+    
+    __recordControl(EMixerControlOp::PlayNewTextureAfterBridge,
+        { float(new_texture), float(bridge_index), fade_out_ratio, fade_in_ratio, bridge_volume });
         
     if (!__is_running)
         return;
@@ -221,7 +363,12 @@ void AAdaptiveMixer::PlayNewTextureAfterBridge(uint8 new_texture, int bridge_ind
         return;
     
     //it's ok:
+    __beginLatency(EControlLatencyEvent::Bridge);
     __bridge_audio_component->SetSound(cue);
+    __bridge_requested_time = FPlatformTime::Seconds();
+    __bridge_audio_component->OnAudioPlaybackPercentNative.RemoveAll(this); // bound before FadeIn, or Play
+    __bridge_audio_component->OnAudioPlaybackPercentNative.AddUObject(this, // won't report progress.
+        &AAdaptiveMixer::__onBridgePlaybackPercent);
     float bridge_duration;
     bridge_duration = __bridge_audio_component->Sound->GetDuration();
     FTimerDelegate crossfade_timer_Del;
@@ -230,16 +377,35 @@ void AAdaptiveMixer::PlayNewTextureAfterBridge(uint8 new_texture, int bridge_ind
     GetWorld()->GetTimerManager().SetTimer(__bridge_timer_handle, crossfade_timer_Del,
     bridge_duration - bridge_duration * fade_in_ratio, false);
     __bridge_audio_component->FadeIn(fade_out_ratio*bridge_duration, __verifiedVolume(bridge_volume * __master_volume), 0.0f);
+    __bridge_pending = true;
+    __bridge_index = bridge_index;
+    __bridge_volume = bridge_volume;
+    __bridge_start_time = GetWorld()->GetAudioTimeSeconds();
+    __bridge_crossfade_time = fade_in_ratio * bridge_duration;
+    ++__bridge_serial;
     __texture = new_texture;
     UE_LOG(AdaptiveMixerLog, Display, TEXT("__texture changed to %d."), __texture);
     for (int i = 0; i < PTRN_COUNT; ++i) {
         __muteTrack(i, bridge_duration * fade_out_ratio);
     }
+    __endLatency(&__bridge_latency_token);
+    
+    if (__isReplicationServer()) {
+        FMixerPackedIndex packed_index;
+        packed_index.value = uint32(bridge_index);
+        __multicastBridge(new_texture, packed_index, FMixerReplication::Quantize(fade_out_ratio),
+            FMixerReplication::Quantize(fade_in_ratio), FMixerReplication::Quantize(bridge_volume));
+    }
 }
 
 
 void AAdaptiveMixer::PlayStinger(int index, float stinger_volume) {
     
+    if (__ignoresLocalControl())
+        return;
+    
+    __recordControl(EMixerControlOp::PlayStinger, { float(index), stinger_volume });
+    
     if (!__is_running)
         return;
     
@@ -254,8 +420,22 @@ void AAdaptiveMixer::PlayStinger(int index, float stinger_volume) {
         return;
     
     //it's ok:
+    __beginLatency(EControlLatencyEvent::Stinger);
     __stinger_audio_component->SetSound(cue);
+    if (__latency_token != 0) {
+        __stinger_audio_component->OnAudioPlaybackPercentNative.RemoveAll(this); // bound before FadeIn.
+        __stinger_audio_component->OnAudioPlaybackPercentNative.AddUObject(this,
+            &AAdaptiveMixer::__onStingerPlaybackPercent);
+    }
     __stinger_audio_component->FadeIn(0.0f, __verifiedVolume(stinger_volume * __master_volume), 0.0f);
+    __endLatency(&__stinger_latency_token);
+    ++__stinger_serial;
+    
+    if (__isReplicationServer()) {
+        FMixerPackedIndex packed_index;
+        packed_index.value = uint32(index);
+        __multicastStinger(packed_index, FMixerReplication::Quantize(stinger_volume));
+    }
 }
 
 void AAdaptiveMixer::InsertPattern(uint8 index) {
@@ -290,6 +470,9 @@ void AAdaptiveMixer::InitializeAllPatternsVolume(float ptrn0_vol, float ptrn1_vo
     float ptrn2_vol, float ptrn3_vol, float ptrn4_vol, float ptrn5_vol,
     float ptrn6_vol, float ptrn7_vol, bool adjust_playback) {
 
+    __recordControl(EMixerControlOp::InitializeAllPatternsVolume, { ptrn0_vol, ptrn1_vol, ptrn2_vol,
+        ptrn3_vol, ptrn4_vol, ptrn5_vol, ptrn6_vol, ptrn7_vol, adjust_playback ? 1.0f : 0.0f });
+
     __patterns_volume[0] = __verifiedVolume(ptrn0_vol);
     __patterns_volume[1] = __verifiedVolume(ptrn1_vol);
     __patterns_volume[2] = __verifiedVolume(ptrn2_vol);
@@ -305,6 +488,8 @@ void AAdaptiveMixer::InitializeAllPatternsVolume(float ptrn0_vol, float ptrn1_vo
 
 void AAdaptiveMixer::SetPatternVolume(uint8 index, float volume) {
     
+    __recordControl(EMixerControlOp::SetPatternVolume, { float(index), volume });
+    
     if (index >= PTRN_COUNT)
         return;
     
@@ -315,6 +500,8 @@ void AAdaptiveMixer::SetPatternVolume(uint8 index, float volume) {
 
 void AAdaptiveMixer::SetAllPatternsVolume(float volume) {
     
+    __recordControl(EMixerControlOp::SetAllPatternsVolume, { volume });
+    
     for (int i = 0; i < PTRN_COUNT; ++i) {
         __patterns_volume[i] = __verifiedVolume(volume);
     }
@@ -322,10 +509,402 @@ void AAdaptiveMixer::SetAllPatternsVolume(float volume) {
 }
 
 void AAdaptiveMixer::SetMasterVolume(float volume) {
+    __recordControl(EMixerControlOp::SetMasterVolume, { volume });
     __master_volume = __verifiedVolume(volume);
     __decodeFromByte(__getFilteredTexture(), __score_fade_time);
 }
 
+UIntensityVector* AAdaptiveMixer::GetIntensityVector() {
+    if (__default_intensity_vector == nullptr)
+        UE_LOG(AdaptiveMixerLog, Error, TEXT("Something went wrong: __default_intensity_vector == nullptr."));
+    return __default_intensity_vector;
+}
+
+void AAdaptiveMixer::SetIntensityMode(bool enabled, float smoothing_time) {
+    
+    __recordControl(EMixerControlOp::SetIntensityMode, { enabled ? 1.0f : 0.0f, smoothing_time });
+    
+    __intensity_smoothing_time = smoothing_time < 0.0f ? 0.0f : smoothing_time;
+    
+    if (__intensity_mode == enabled)
+        return;
+    
+    __intensity_mode = enabled;
+    __decodeFromByte(__processed_texture, __score_fade_time);
+}
+
+void AAdaptiveMixer::SetIntensity(uint8 parameter, float value) {
+    
+    __recordControl(EMixerControlOp::SetIntensity, { float(parameter), value });
+    
+    __default_intensity_vector->SetParameter(parameter, value);
+    
+    if (__intensity_mode)
+        __decodeFromByte(__processed_texture, __intensity_smoothing_time);
+}
+
+UTextureArbiter* AAdaptiveMixer::GetTextureArbiter() {
+    if (__default_texture_arbiter == nullptr)
+        UE_LOG(AdaptiveMixerLog, Error, TEXT("Something went wrong: __default_texture_arbiter == nullptr."));
+    return __default_texture_arbiter;
+}
+
+void AAdaptiveMixer::StartTextureArbitration(float min_transition_interval) {
+    
+    if (min_transition_interval <= 0.0f)
+        return;
+    
+    FTimerDelegate arbitration_timer_Del;
+    arbitration_timer_Del.BindUFunction(this, FName("__onArbitrationTimer"));
+    GetWorld()->GetTimerManager().SetTimer(__arbitration_timer_handle, arbitration_timer_Del,
+    min_transition_interval, true);
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("Texture arbitration started (every %f s)."), min_transition_interval);
+}
+
+void AAdaptiveMixer::StopTextureArbitration() {
+    GetWorld()->GetTimerManager().ClearTimer(__arbitration_timer_handle);
+}
+
+void AAdaptiveMixer::SetFadeEngine(bool enabled, FString curve, UCurveFloat* custom_curve) {
+    
+    EStemFadeCurve parsed_curve;
+    if (!FStemFadeEngine::ParseCurveName(curve, parsed_curve)) {
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Unknown fade curve \"%s\"."), *curve);
+        return;
+    }
+    __recordControl(EMixerControlOp::SetFadeEngine, { enabled ? 1.0f : 0.0f, float(parsed_curve) },
+        custom_curve ? custom_curve->GetPathName() : FString());
+    
+    if (!__fade_engine.IsValid())
+        __fade_engine = MakeShared<FStemFadeEngine, ESPMode::ThreadSafe>();
+    __fade_engine->SetCurve(parsed_curve, custom_curve);
+    
+    if (__fade_engine_enabled == enabled)
+        return;
+    
+    __fade_engine_enabled = enabled;
+    __routeFadeEngine();
+    if (enabled && __is_running)
+        __startDucking();
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("Audio-thread fade engine %s."), enabled ? TEXT("enabled") : TEXT("disabled"));
+}
+
+void AAdaptiveMixer::__routeFadeEngine() {
+    
+    // only a stem that runs UStemGainSourcePreset can take its gain from the engine,
+    // the others (a container wave has no effect chain) stay on component fades:
+    uint8 routed = 0;
+    for (int i = 0; (i < PTRN_COUNT) && __fade_engine_enabled; ++i) {
+        if (__patterns_validation[i] != TRUE)
+            continue;
+        if (__hasStemGainSource(__pattern_audio_components[i]->Sound))
+            routed |= 1 << i;
+        else
+            UE_LOG(AdaptiveMixerLog, Warning, TEXT("Pattern %d has no UStemGainSourcePreset, it keeps component fades."), i);
+    }
+    
+    // hand the current gains over without a jump:
+    uint8 toggled = routed ^ __fade_engine_stems;
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (!(toggled & (1 << i)))
+            continue;
+        uint64 component_id = __pattern_audio_components[i]->GetAudioComponentID();
+        bool playing = __is_running && (__patterns_validation[i] == TRUE);
+        if (routed & (1 << i)) {
+            __fade_engine->SetTarget(i, __applied_gains[i], 0.0f);
+            FStemFadeEngine::Register(component_id, __fade_engine, i);
+            if (playing)
+                __pattern_audio_components[i]->AdjustVolume(0.0f, 1.0f);
+        }
+        else {
+            FStemFadeEngine::Unregister(component_id);
+            if (playing)
+                __pattern_audio_components[i]->AdjustVolume(0.0f, __applied_gains[i]);
+        }
+    }
+    __fade_engine_stems = routed;
+}
+
+bool AAdaptiveMixer::__isOnFadeEngine(uint8 index) const {
+    return (__fade_engine_stems & (1 << index)) != 0;
+}
+
+bool AAdaptiveMixer::__hasStemGainSource(USoundBase* sound) {
+    
+    auto has_preset = [](USoundBase* s) {
+        if ((s == nullptr) || (s->SourceEffectChain == nullptr))
+            return false;
+        for (const FSourceEffectChainEntry& entry : s->SourceEffectChain->Chain) {
+            if (Cast<UStemGainSourcePreset>(entry.Preset) != nullptr)
+                return true;
+        }
+        return false;
+    };
+    
+    if (has_preset(sound))
+        return true;
+    
+    // a cue without a chain of its own plays its waves with theirs:
+    USoundCue* cue = Cast<USoundCue>(sound);
+    if ((cue == nullptr) || (cue->SourceEffectChain != nullptr))
+        return false;
+    TArray<USoundNodeWavePlayer*> players;
+    cue->RecursiveFindNode<USoundNodeWavePlayer>(cue->FirstNode, players);
+    for (USoundNodeWavePlayer* player : players) {
+        if (!has_preset(player->GetSoundWave()))
+            return false;
+    }
+    return players.Num() > 0;
+}
+
+UTextureRuleSet* AAdaptiveMixer::GetTextureRuleSet() {
+    if (__default_texture_rule_set == nullptr)
+        UE_LOG(AdaptiveMixerLog, Error, TEXT("Something went wrong: __default_texture_rule_set == nullptr."));
+    return __default_texture_rule_set;
+}
+
+void AAdaptiveMixer::StartTextureRules(float rate_hz) {
+    
+    if (rate_hz <= 0.0f)
+        return;
+    
+    FTimerDelegate rules_timer_Del;
+    rules_timer_Del.BindUFunction(this, FName("__onTextureRulesTimer"));
+    GetWorld()->GetTimerManager().SetTimer(__texture_rules_timer_handle, rules_timer_Del,
+    1.0f / rate_hz, true);
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("Texture rules started (%f Hz)."), rate_hz);
+}
+
+void AAdaptiveMixer::StopTextureRules() {
+    GetWorld()->GetTimerManager().ClearTimer(__texture_rules_timer_handle);
+}
+
+void AAdaptiveMixer::ApplyCommandBatch(const FMixerCommandBatch& command_batch) {
+    
+    // a replica follows the server's texture and stingers, only the volumes are its own:
+    FMixerCommandBatch batch = command_batch;
+    if (__ignoresLocalControl()) {
+        batch.set_texture = false;
+        batch.or_mask = 0;
+        batch.and_mask = 255;
+        batch.stinger_index = -1;
+    }
+    
+    if (__control_log.IsRecording()) {
+        TArray<float> args = { batch.set_texture ? 1.0f : 0.0f, float(batch.texture), float(batch.or_mask),
+            float(batch.and_mask), batch.master_volume, batch.fade_time, float(batch.stinger_index),
+            batch.stinger_volume };
+        for (int i = 0; i < PTRN_COUNT; ++i) {
+            args.Add(i < batch.pattern_volumes.Num() ? batch.pattern_volumes[i] : -1.0f);
+        }
+        __recordControl(EMixerControlOp::ApplyCommandBatch, args);
+    }
+    TGuardValue<bool> nested_guard(__control_nested, true);
+    
+    uint8 new_texture = batch.set_texture ? batch.texture : __texture;
+    new_texture |= batch.or_mask;
+    new_texture &= batch.and_mask;
+    
+    bool changed = false;
+    
+    if (__is_running && (new_texture != __texture)) {
+        __beginLatency(EControlLatencyEvent::Texture);
+        __texture = new_texture;
+        changed = true;
+        UE_LOG(AdaptiveMixerLog, Display, TEXT("__texture changed to %d (batch)"), __texture);
+    }
+    
+    int volumes_count = FMath::Min(batch.pattern_volumes.Num(), int(PTRN_COUNT));
+    for (int i = 0; i < volumes_count; ++i) {
+        if (batch.pattern_volumes[i] >= 0.0f) {
+            __patterns_volume[i] = __verifiedVolume(batch.pattern_volumes[i]);
+            changed = true;
+        }
+    }
+    
+    if (batch.master_volume >= 0.0f) {
+        __master_volume = __verifiedVolume(batch.master_volume);
+        changed = true;
+    }
+    
+    if (changed) {
+        float fade = (batch.fade_time >= 0.0f) ? batch.fade_time : __score_fade_time;
+        __decodeFromByte(__getFilteredTexture(), fade);
+    }
+    __endLatency(); // before the stinger, which is measured on its own.
+    
+    if (batch.stinger_index >= 0)
+        PlayStinger(batch.stinger_index, batch.stinger_volume);
+}
+
+void AAdaptiveMixer::StartControlRecording() {
+    
+    __control_log.Begin(GFrameCounter, __getAudioClock());
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("Control recording started."));
+}
+
+bool AAdaptiveMixer::StopControlRecording(FString file_path) {
+    
+    if (!__control_log.IsRecording())
+        return false;
+    
+    __control_log.End();
+    bool saved = __control_log.Save(file_path);
+    if (saved) {
+        UE_LOG(AdaptiveMixerLog, Display, TEXT("Control recording saved: %d events -> %s"),
+            __control_log.GetEvents().Num(), *file_path);
+    }
+    else {
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Can't save control recording to %s."), *file_path);
+    }
+    return saved;
+}
+
+void AAdaptiveMixer::ReplayControlEvent(const FMixerControlEvent& event) {
+    
+    const FMixerControlEvent& e = event;
+    switch (e.op) {
+        case EMixerControlOp::Run:
+            Run(uint8(e.Arg(0)));
+            break;
+        case EMixerControlOp::Stop:
+            Stop();
+            break;
+        case EMixerControlOp::PlayNewTexture:
+            PlayNewTexture(uint8(e.Arg(0)));
+            break;
+        case EMixerControlOp::PlayNewTextureAfterBridge:
+            PlayNewTextureAfterBridge(uint8(e.Arg(0)), int(e.Arg(1)), e.Arg(2), e.Arg(3), e.Arg(4, 1.0f));
+            break;
+        case EMixerControlOp::PlayStinger:
+            PlayStinger(int(e.Arg(0)), e.Arg(1, 1.0f));
+            break;
+        case EMixerControlOp::SetPatternVolume:
+            SetPatternVolume(uint8(e.Arg(0)), e.Arg(1, 1.0f));
+            break;
+        case EMixerControlOp::SetAllPatternsVolume:
+            SetAllPatternsVolume(e.Arg(0, 1.0f));
+            break;
+        case EMixerControlOp::InitializeAllPatternsVolume:
+            InitializeAllPatternsVolume(e.Arg(0, 1.0f), e.Arg(1, 1.0f), e.Arg(2, 1.0f), e.Arg(3, 1.0f),
+                e.Arg(4, 1.0f), e.Arg(5, 1.0f), e.Arg(6, 1.0f), e.Arg(7, 1.0f), e.Arg(8) != 0.0f);
+            break;
+        case EMixerControlOp::SetMasterVolume:
+            SetMasterVolume(e.Arg(0, 1.0f));
+            break;
+        case EMixerControlOp::ApplyCommandBatch: {
+            FMixerCommandBatch batch;
+            batch.set_texture = e.Arg(0) != 0.0f;
+            batch.texture = uint8(e.Arg(1));
+            batch.or_mask = uint8(e.Arg(2));
+            batch.and_mask = uint8(e.Arg(3, 255.0f));
+            batch.master_volume = e.Arg(4, -1.0f);
+            batch.fade_time = e.Arg(5, -1.0f);
+            batch.stinger_index = int(e.Arg(6, -1.0f));
+            batch.stinger_volume = e.Arg(7, 1.0f);
+            for (int i = 0; i < PTRN_COUNT; ++i) {
+                batch.pattern_volumes.Add(e.Arg(8 + i, -1.0f));
+            }
+            ApplyCommandBatch(batch);
+            break;
+        }
+        case EMixerControlOp::SetIntensityMode:
+            SetIntensityMode(e.Arg(0) != 0.0f, e.Arg(1, 0.1f));
+            break;
+        case EMixerControlOp::SetIntensity:
+            SetIntensity(uint8(e.Arg(0)), e.Arg(1));
+            break;
+        case EMixerControlOp::Prepare: {
+            TArray<int> bridge_indices;
+            for (float index : e.args) {
+                bridge_indices.Add(int(index));
+            }
+            Prepare(bridge_indices);
+            break;
+        }
+        case EMixerControlOp::RestoreSnapshot: {
+            FMixerSnapshot snapshot;
+            if (e.object_path.IsEmpty())
+                snapshot.score = __loaded_score;
+            else
+                snapshot.score = TSoftObjectPtr<UAdaptiveScore>(FSoftObjectPath(e.object_path));
+            snapshot.was_running = e.Arg(0) != 0.0f;
+            snapshot.texture = uint8(e.Arg(1));
+            snapshot.master_volume = e.Arg(2, 1.0f);
+            snapshot.playback_position = e.Arg(3);
+            snapshot.bridge_pending = e.Arg(4) != 0.0f;
+            snapshot.bridge_index = int(e.Arg(5, -1.0f));
+            snapshot.bridge_volume = e.Arg(6, 1.0f);
+            snapshot.bridge_position = e.Arg(7);
+            snapshot.bridge_timer_remaining = e.Arg(8);
+            snapshot.bridge_crossfade_time = e.Arg(9);
+            for (int i = 0; i < PTRN_COUNT; ++i) {
+                snapshot.pattern_volumes.Add(e.Arg(10 + i, 1.0f));
+            }
+            for (int a = 10 + PTRN_COUNT; a + 3 < e.args.Num(); a += 4) {
+                int operation = int(e.Arg(a + 1, -1.0f));
+                FFilter filter;
+                filter.SetTrack(uint8(e.Arg(a)));
+                if ((operation >= 0) && (operation < int(UE_ARRAY_COUNT(LOGGED_FILTER_OPERATIONS))))
+                    filter.SetOperation(LOGGED_FILTER_OPERATIONS[operation]);
+                filter.SetMask(uint8(e.Arg(a + 2)));
+                filter.SetTerminate(e.Arg(a + 3) != 0.0f);
+                snapshot.dynamic_filters.Add(filter);
+            }
+            RestoreSnapshot(snapshot);
+            break;
+        }
+        case EMixerControlOp::SetFadeEngine: {
+            int curve = FMath::Clamp(int(e.Arg(1, 1.0f)), 0, int(UE_ARRAY_COUNT(LOGGED_FADE_CURVES)) - 1);
+            UCurveFloat* custom_curve = e.object_path.IsEmpty() ? nullptr : LoadObject<UCurveFloat>(nullptr, *e.object_path);
+            SetFadeEngine(e.Arg(0) != 0.0f, LOGGED_FADE_CURVES[curve], custom_curve);
+            break;
+        }
+        case EMixerControlOp::AddScoreLayer: {
+            UAdaptiveScore* score = e.object_path.IsEmpty() ? nullptr : LoadObject<UAdaptiveScore>(nullptr, *e.object_path);
+            if (score == nullptr) {
+                UE_LOG(AdaptiveMixerLog, Warning, TEXT("Logged layer score \"%s\" doesn't load, layer skipped."), *e.object_path);
+                break;
+            }
+            AddScoreLayer(score, e.Arg(0, 1.0f));
+            break;
+        }
+        case EMixerControlOp::RemoveScoreLayer:
+            RemoveScoreLayer(int(e.Arg(0)));
+            break;
+        case EMixerControlOp::StartLayer:
+            StartLayer(int(e.Arg(0)), uint8(e.Arg(1)), e.Arg(2, 1.0f) != 0.0f);
+            break;
+        case EMixerControlOp::StopLayer:
+            StopLayer(int(e.Arg(0)), e.Arg(1, 1.0f) != 0.0f);
+            break;
+        case EMixerControlOp::SetLayerTexture:
+            SetLayerTexture(int(e.Arg(0)), uint8(e.Arg(1)), e.Arg(2, 1.0f) != 0.0f);
+            break;
+        case EMixerControlOp::SetLayerVolume:
+            SetLayerVolume(int(e.Arg(0)), e.Arg(1, 1.0f));
+            break;
+        case EMixerControlOp::SetBarLength:
+            SetBarLength(e.Arg(0));
+            break;
+        case EMixerControlOp::AddListenerSet:
+            AddListenerSet(uint8(e.Arg(0)));
+            break;
+        case EMixerControlOp::RemoveListenerSet:
+            RemoveListenerSet(int(e.Arg(0)));
+            break;
+        case EMixerControlOp::SetListenerTexture:
+            SetListenerTexture(int(e.Arg(0)), uint8(e.Arg(1)));
+            break;
+        case EMixerControlOp::SetListenerPatternVolume:
+            SetListenerPatternVolume(int(e.Arg(0)), uint8(e.Arg(1)), e.Arg(2, 1.0f));
+            break;
+        default:
+            UE_LOG(AdaptiveMixerLog, Warning, TEXT("Unknown control op %d, skipped."), int(e.op));
+            break;
+    }
+}
+
 uint8 AAdaptiveMixer::BinaryToDecimal(int binary_number) {
     
     int num = binary_number;
@@ -456,113 +1035,1322 @@ void AAdaptiveMixer::LogAllPlaybackTime() {
 }
 
 
-bool AAdaptiveMixer::IsRunning() {
-    return __is_running;
+bool AAdaptiveMixer::Prepare(const TArray<int>& bridge_indices) {
+    
+    if (__ignoresLocalControl())
+        return false;
+    
+    if (__control_log.IsRecording()) {
+        TArray<float> args;
+        for (int index : bridge_indices) {
+            args.Add(float(index));
+        }
+        __recordControl(EMixerControlOp::Prepare, args);
+    }
+    
+    if (!__is_initialized || __is_running) {
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Prepare needs an initialized mixer that isn't running."));
+        return false;
+    }
+    
+    if (__prepared)
+        return true;
+    
+    __acquireCues();
+    __optimizeFilterChains();
+    __armStartProbe();
+    
+    // the sources start and fill their first buffers, then hold:
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (__patterns_validation[i] == TRUE) {
+            if (__container_waves[i] != nullptr)
+                __container_waves[i]->SeekTo(0.0f);
+            __pattern_audio_components[i]->Play(0.0f);
+            __pattern_audio_components[i]->SetPaused(true);
+            __adjustPatternVolume(i, 0.0f, 0.0f);
+        }
+    }
+    
+    int precached = 0;
+    FAudioDevice* device = GetWorld()->GetAudioDevice();
+    for (int b = 0; (device != nullptr) && (b < __bridge_sound_cues.Num()); ++b) {
+        USoundCue* cue = __bridge_sound_cues[b];
+        if (((bridge_indices.Num() > 0) && !bridge_indices.Contains(b)) || !__isSoundBaseValid(cue))
+            continue;
+        
+        TArray<USoundNodeWavePlayer*> players;
+        cue->RecursiveFindNode<USoundNodeWavePlayer>(cue->FirstNode, players);
+        for (USoundNodeWavePlayer* player : players) {
+            if (USoundWave* wave = player->GetSoundWave()) {
+                device->Precache(wave);
+                ++precached;
+            }
+        }
+    }
+    
+    __prepared = true;
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("Adaptive mixer prepared (%d bridge waves precached)."), precached);
+    return true;
 }
 
-bool AAdaptiveMixer::IsInitialized() {
-    return __is_initialized;
+bool AAdaptiveMixer::IsPrepared() {
+    return __prepared;
 }
 
-uint8 AAdaptiveMixer::GetTexture() {
-    return __texture;
+float AAdaptiveMixer::GetStartLatency() {
+    return __start_latency;
 }
 
-bool AAdaptiveMixer::__isSoundBaseValid(USoundBase* base_ptr) {
+float AAdaptiveMixer::GetBridgeStartLatency() {
+    return __bridge_start_latency;
+}
+
+void AAdaptiveMixer::__discardPreroll() {
     
-    bool result = false;
+    if (!__prepared)
+        return;
     
-    if (IsValid(base_ptr)) {
-        if (base_ptr->IsValidLowLevelFast()) {
-            result = true;
-        }
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (__patterns_validation[i] == TRUE)
+            __pattern_audio_components[i]->Stop();
     }
-    return result;
+    FStemCache::Get().Release(this);
+    __prepared = false;
 }
 
-uint8 AAdaptiveMixer::__getFilteredTexture() {
+void AAdaptiveMixer::__armStartProbe() {
     
-    uint8 result;
-    if (__default_dynamic_filter_chain->IsAvailable()) {
-        result = __default_dynamic_filter_chain->ApplyDynamicFilterChain(__texture);
-        UE_LOG(AdaptiveMixerLog, Display, TEXT("Processing texture with Dynamic FCH..."));
+    __start_probe_percent = -1.0f;
+    
+    // one stem is enough, they all start together. Bound before Play, or Play
+    // doesn't ask the audio thread for progress:
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        __pattern_audio_components[i]->OnAudioPlaybackPercentNative.RemoveAll(this);
     }
-    else {
-        result = UStaticFilterChain::ApplyFilterChain(__texture, __score_filterchain_index);
-        UE_LOG(AdaptiveMixerLog, Display, TEXT("Processing texture with Static FCH..."));
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (__patterns_validation[i] == TRUE) {
+            __pattern_audio_components[i]->OnAudioPlaybackPercentNative.AddUObject(this,
+                &AAdaptiveMixer::__onStemPlaybackPercent);
+            break;
+        }
     }
-    return result;
 }
 
-void AAdaptiveMixer::__initializeDefaultVolume() {
+// Progress comes to the game thread after the audio thread rendered the buffer,
+// so both latencies are up to a frame longer than what is heard.
+
+void AAdaptiveMixer::__onStemPlaybackPercent(const UAudioComponent* component, const USoundWave* wave, const float percent) {
+    
+    if (__start_requested_time == 0.0) { // primed by Prepare, Run hasn't come yet.
+        __start_probe_percent = percent;
+        return;
+    }
+    if (percent <= __start_probe_percent) // a report of the preroll, not played since Run.
+        return;
     
+    __start_latency = float((FPlatformTime::Seconds() - __start_requested_time) * 1000.0);
+    __start_requested_time = 0.0;
+    __completeStartLatency(__run_latency_token);
     for (int i = 0; i < PTRN_COUNT; ++i) {
-        __patterns_volume[i] = 1.0f;
+        __pattern_audio_components[i]->OnAudioPlaybackPercentNative.RemoveAll(this);
     }
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("Start latency: %.1f ms."), __start_latency);
 }
 
-void AAdaptiveMixer::__onBridgeCrossfadeTimer(float fade) {
+void AAdaptiveMixer::__onBridgePlaybackPercent(const UAudioComponent* component, const USoundWave* wave, const float percent) {
     
-    if (!__is_running)
-        return; 
+    if (__bridge_requested_time == 0.0)
+        return;
     
-    __beginToPlaySilently();
-    __decodeFromByte(__getFilteredTexture(), fade);
-    __bridge_audio_component->FadeOut(fade, 0.0f);
+    __bridge_start_latency = float((FPlatformTime::Seconds() - __bridge_requested_time) * 1000.0);
+    __bridge_requested_time = 0.0;
+    __completeStartLatency(__bridge_latency_token);
+    __bridge_audio_component->OnAudioPlaybackPercentNative.RemoveAll(this);
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("Bridge start latency: %.1f ms."), __bridge_start_latency);
 }
 
-void AAdaptiveMixer::__muteTrack(uint8 index, float fade) {
+void AAdaptiveMixer::__onStingerPlaybackPercent(const UAudioComponent* component, const USoundWave* wave, const float percent) {
     
-    if (__patterns_validation[index] == TRUE) {
-        __pattern_audio_components[index]->FadeOut(fade, 0.0f);
-    }
+    __stinger_audio_component->OnAudioPlaybackPercentNative.RemoveAll(this);
+    __completeStartLatency(__stinger_latency_token);
 }
 
-float AAdaptiveMixer::__verifiedVolume(float volume) {
+void AAdaptiveMixer::__beginLatency(EControlLatencyEvent type) {
     
-    if (volume < 0.0f)
-        return 0.0f;
-    else if (volume > 1.0f)
-        return 1.0f;
-    else
-        return volume;
+    if (__latency_token != 0) // nested call, the outer one measures.
+        return;
+    __latency_token = FControlLatencyTracker::Get().Begin(type);
+    __latency_on_render = false;
+    __latency_on_audio_thread = false;
 }
 
-void AAdaptiveMixer::__adjustPatternVolume(uint8 index, float volume, float fade) {
+void AAdaptiveMixer::__endLatency(uint32* started_sound_token) {
     
-    if (__patterns_validation[index] == TRUE) {
-            
-        __pattern_audio_components[index]->AdjustVolume(fade, volume * __master_volume);
+    uint32 token = __latency_token;
+    __latency_token = 0;
+    if (token == 0)
+        return;
+    
+    // a sound started: heard when it first reports playback, gains don't matter before:
+    if (started_sound_token != nullptr) {
+        FControlLatencyTracker::Get().Cancel(*started_sound_token); // cut off before it was heard.
+        *started_sound_token = token;
+    }
+    else if (__latency_on_render) {
+        // the fade engine completes it in the render buffer.
+    }
+    else if (__latency_on_audio_thread) {
+        FControlLatencyTracker::Get().CompleteOnRender(GetWorld()->GetAudioDevice(), token);
+    }
+    else {
+        FControlLatencyTracker::Get().Cancel(token); // nothing audible changed.
     }
 }
 
-void AAdaptiveMixer::__decodeFromByte(uint8 processed_texture, float fade) {
+void AAdaptiveMixer::__completeStartLatency(uint32& started_sound_token) {
     
-    if (!__is_running)
-        return;
+    FControlLatencyTracker::Get().Complete(started_sound_token);
+    started_sound_token = 0;
+}
+
+bool AAdaptiveMixer::IsRunning() {
+    return __is_running;
+}
+
+bool AAdaptiveMixer::IsInitialized() {
+    return __is_initialized;
+}
+
+uint8 AAdaptiveMixer::GetTexture() {
+    return __texture;
+}
+
+float AAdaptiveMixer::GetPlaybackPosition() {
     
-    bool b[PTRN_COUNT];
-    UStaticFilterChain::BoolArrayFromByte(processed_texture, b);
+    if (!__is_running)
+        return 0.0f;
     
-    for (int i = 0; i < PTRN_COUNT; ++i) {
-        float volume = (b[i]) ? (__patterns_volume[i]) : 0.0f;
-        __adjustPatternVolume(i, volume, fade);
+    float position = GetWorld()->GetAudioTimeSeconds() - __transport_start_time;
+    return (__pattern_length > 0.0f) ? FMath::Fmod(position, __pattern_length) : position;
+}
+
+FMixerSnapshot AAdaptiveMixer::CaptureSnapshot() {
+    
+    FMixerSnapshot snapshot;
+    if (!__is_initialized)
+        return snapshot;
+    
+    snapshot.score = __loaded_score;
+    snapshot.score_id = FMixerReplication::FindScoreId(GetWorld(), __loaded_score);
+    snapshot.dynamic_filters = __default_dynamic_filter_chain->GetFilters();
+    snapshot.was_running = __is_running;
+    snapshot.texture = __texture;
+    snapshot.pattern_volumes.Append(__patterns_volume, PTRN_COUNT);
+    snapshot.master_volume = __master_volume;
+    snapshot.playback_position = GetPlaybackPosition();
+    
+    FTimerManager& timers = GetWorld()->GetTimerManager();
+    if (__is_running && __bridge_pending && timers.IsTimerActive(__bridge_timer_handle)) {
+        snapshot.bridge_pending = true;
+        snapshot.bridge_index = __bridge_index;
+        snapshot.bridge_volume = __bridge_volume;
+        snapshot.bridge_position = GetWorld()->GetAudioTimeSeconds() - __bridge_start_time;
+        snapshot.bridge_timer_remaining = timers.GetTimerRemaining(__bridge_timer_handle);
+        snapshot.bridge_crossfade_time = __bridge_crossfade_time;
     }
+    return snapshot;
 }
 
-void AAdaptiveMixer::__beginToPlaySilently() {
+bool AAdaptiveMixer::RestoreSnapshot(const FMixerSnapshot& snapshot) {
     
-    for (int i = 0; i < PTRN_COUNT; ++i) {
-        if (__patterns_validation[i] == TRUE) {
-            __pattern_audio_components[i]->Play();
-        }
+    if (__ignoresLocalControl())
+        return false;
+    
+    if (snapshot.score.IsNull() && (snapshot.score_id == 0)) {
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Empty snapshot, nothing to restore."));
+        return false;
     }
-    for (int i = 0; i < PTRN_COUNT; ++i) {
-        __adjustPatternVolume(i, 0.0f, 0.0f);
+    
+    UAdaptiveScore* score = FMixerReplication::FindScore(GetWorld(), uint16(snapshot.score_id));
+    if (score == nullptr)
+        score = snapshot.score.Get();
+    if ((score == nullptr) && snapshot.score.ToSoftObjectPath().IsAsset())
+        score = snapshot.score.LoadSynchronous();
+    if (score == nullptr) {
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Snapshot score %s (id %d) is gone, nothing to restore."),
+            *snapshot.score.ToString(), snapshot.score_id);
+        return false;
     }
-}
+    
+    if (__control_log.IsRecording()) {
+        TArray<float> args = { snapshot.was_running ? 1.0f : 0.0f, float(snapshot.texture), snapshot.master_volume,
+            snapshot.playback_position, snapshot.bridge_pending ? 1.0f : 0.0f, float(snapshot.bridge_index),
+            snapshot.bridge_volume, snapshot.bridge_position, snapshot.bridge_timer_remaining,
+            snapshot.bridge_crossfade_time };
+        for (int i = 0; i < PTRN_COUNT; ++i) {
+            args.Add(i < snapshot.pattern_volumes.Num() ? snapshot.pattern_volumes[i] : 1.0f);
+        }
+        for (FFilter filter : snapshot.dynamic_filters) {
+            int operation = INDEX_NONE;
+            for (int o = 0; o < int(UE_ARRAY_COUNT(LOGGED_FILTER_OPERATIONS)); ++o) {
+                if (filter.GetOperation() == LOGGED_FILTER_OPERATIONS[o])
+                    operation = o;
+            }
+            args.Append({ float(filter.GetTrack()), float(operation), float(filter.GetMask()),
+                filter.IsTerminate() ? 1.0f : 0.0f });
+        }
+        // the loaded score goes without a path, the replay restores onto its own:
+        __recordControl(EMixerControlOp::RestoreSnapshot, args,
+            score == __loaded_score ? FString() : score->GetPathName());
+    }
+    TGuardValue<bool> nested_guard(__control_nested, true);
+    
+    if (__is_running)
+        Stop();
+    
+    // same score: the cues are already set on the components.
+    // Otherwise a score still in memory brings its cues along (see FStemCache), nothing is loaded again.
+    if (!__is_initialized || (__loaded_score != score)) {
+        if (!InitializeMixer(score, snapshot.master_volume))
+            return false;
+    }
+    
+    __default_dynamic_filter_chain->SetFilters(snapshot.dynamic_filters);
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        __patterns_volume[i] = i < snapshot.pattern_volumes.Num() ? __verifiedVolume(snapshot.pattern_volumes[i]) : 1.0f;
+    }
+    __master_volume = __verifiedVolume(snapshot.master_volume);
+    __texture = snapshot.texture;
+    
+    if (!snapshot.was_running)
+        return true;
+    
+    __acquireCues();
+    __optimizeFilterChains(); // SetFilters above made a new revision.
+    __armStartProbe();
+    __is_running = true;
+    __startDucking();
+    
+    if (snapshot.bridge_pending && (snapshot.bridge_index >= 0) &&
+        (snapshot.bridge_index < __bridge_sound_cues.Num()) &&
+        __isSoundBaseValid(__bridge_sound_cues[snapshot.bridge_index])) {
+        // patterns are silent under the bridge, they come back on the crossfade timer:
+        __beginLatency(EControlLatencyEvent::Bridge);
+        __bridge_audio_component->SetSound(__bridge_sound_cues[snapshot.bridge_index]);
+        __bridge_requested_time = FPlatformTime::Seconds();
+        __bridge_audio_component->OnAudioPlaybackPercentNative.RemoveAll(this); // bound before FadeIn.
+        __bridge_audio_component->OnAudioPlaybackPercentNative.AddUObject(this,
+            &AAdaptiveMixer::__onBridgePlaybackPercent);
+        __bridge_audio_component->FadeIn(RESTORE_FADE_TIME, __verifiedVolume(snapshot.bridge_volume * __master_volume),
+            snapshot.bridge_position);
+        __bridge_pending = true;
+        __bridge_index = snapshot.bridge_index;
+        __bridge_volume = snapshot.bridge_volume;
+        __bridge_start_time = GetWorld()->GetAudioTimeSeconds() - snapshot.bridge_position;
+        __bridge_crossfade_time = snapshot.bridge_crossfade_time;
+        
+        FTimerDelegate crossfade_timer_Del;
+        crossfade_timer_Del.BindUFunction(this, FName("__onBridgeCrossfadeTimer"), snapshot.bridge_crossfade_time);
+        GetWorld()->GetTimerManager().SetTimer(__bridge_timer_handle, crossfade_timer_Del,
+        FMath::Max(snapshot.bridge_timer_remaining, KINDA_SMALL_NUMBER), false);
+        __endLatency(&__bridge_latency_token);
+    }
+    else {
+        // measured like Run, heard when the stems first report playback:
+        __start_requested_time = FPlatformTime::Seconds();
+        __beginLatency(EControlLatencyEvent::Run);
+        __beginToPlaySilently(snapshot.playback_position);
+        __decodeFromByte(__getFilteredTexture(), RESTORE_FADE_TIME);
+        __endLatency(&__run_latency_token);
+    }
+    
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("Adaptive mixer restored (texture %d, position %f)."),
+        __texture, snapshot.playback_position);
+    return true;
+}
 
-AAdaptiveMixer::~AAdaptiveMixer() {
+int AAdaptiveMixer::AddScoreLayer(UAdaptiveScore* score, float layer_volume) {
+    
+    __recordControl(EMixerControlOp::AddScoreLayer, { layer_volume }, score ? score->GetPathName() : FString());
+    
+    FStemCache::Get().RegisterLayer(this, score); // evicted cues come back here.
+    UScoreLayer* layer = NewObject<UScoreLayer>(this);
+    if (!layer->Initialize(this, score, layer_volume)) {
+        FStemCache::Get().UnregisterLayer(this, score);
+        layer->Release();
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Score layer initialization failed."));
+        return -1;
+    }
+    
+    int index = __layers.Add(layer);
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("Score layer %d added."), index);
+    return index;
+}
+
+void AAdaptiveMixer::RemoveScoreLayer(int layer) {
+    
+    __recordControl(EMixerControlOp::RemoveScoreLayer, { float(layer) });
+    
+    UScoreLayer* l = __getLayer(layer);
+    if (l == nullptr)
+        return;
+    
+    l->Release();
+    FStemCache::Get().UnregisterLayer(this, l->GetScore());
+    __layers.RemoveAt(layer);
+}
+
+UDynamicFilterChain* AAdaptiveMixer::GetLayerFilterChain(int layer) {
+    
+    UScoreLayer* l = __getLayer(layer);
+    return l ? l->GetDynamicFilterChain() : nullptr;
+}
+
+void AAdaptiveMixer::StartLayer(int layer, uint8 initial_texture, bool on_bar) {
+    
+    __recordControl(EMixerControlOp::StartLayer, { float(layer), float(initial_texture), on_bar ? 1.0f : 0.0f });
+    
+    if (UScoreLayer* l = __getLayer(layer))
+        __queueLayerChange(l, true, initial_texture, on_bar);
+}
+
+void AAdaptiveMixer::StopLayer(int layer, bool on_bar) {
+    
+    __recordControl(EMixerControlOp::StopLayer, { float(layer), on_bar ? 1.0f : 0.0f });
+    
+    if (UScoreLayer* l = __getLayer(layer))
+        __queueLayerChange(l, false, l->GetWantedTexture(), on_bar);
+}
+
+void AAdaptiveMixer::SetLayerTexture(int layer, uint8 new_texture, bool on_bar) {
+    
+    __recordControl(EMixerControlOp::SetLayerTexture, { float(layer), float(new_texture), on_bar ? 1.0f : 0.0f });
+    
+    if (UScoreLayer* l = __getLayer(layer))
+        __queueLayerChange(l, l->GetWantedActive(), new_texture, on_bar);
+}
+
+void AAdaptiveMixer::SetLayerVolume(int layer, float volume) {
+    
+    __recordControl(EMixerControlOp::SetLayerVolume, { float(layer), volume });
+    
+    UScoreLayer* l = __getLayer(layer);
+    if (l == nullptr)
+        return;
+    
+    l->SetVolume(__verifiedVolume(volume));
+    __decodeLayers(__score_fade_time);
+}
+
+void AAdaptiveMixer::SetBarLength(float seconds) {
+    
+    __recordControl(EMixerControlOp::SetBarLength, { seconds });
+    __bar_length = seconds < 0.0f ? 0.0f : seconds;
+}
+
+int AAdaptiveMixer::GetLayerCount() {
+    return __layers.Num();
+}
+
+bool AAdaptiveMixer::__isSoundBaseValid(USoundBase* base_ptr) {
+    
+    bool result = false;
+    
+    if (IsValid(base_ptr)) {
+        if (base_ptr->IsValidLowLevelFast()) {
+            result = true;
+        }
+    }
+    return result;
+}
+
+void AAdaptiveMixer::__acquireCues() {
+    
+    FStemCache::Get().Acquire(this);
+    if (!__cues_evicted)
+        return;
+    
+    // the score has its cues back, hand them to the components again:
+    TArray<USoundCue*> patterns = __loaded_score->GetPatternCues();
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (__container_waves[i] != nullptr)
+            continue;
+        USoundCue* cue = i < patterns.Num() ? patterns[i] : nullptr;
+        bool validCue = (__patterns_validation[i] == TRUE) && __isSoundBaseValid(cue);
+        if (validCue)
+            __pattern_audio_components[i]->SetSound(cue);
+        __patterns_validation[i] = validCue ? TRUE : FALSE;
+    }
+    __bridge_sound_cues = __loaded_score->GetBridgeCues();
+    __stinger_sound_cues = __loaded_score->GetStingerCues();
+    __cues_evicted = false;
+}
+
+void AAdaptiveMixer::OnScoreCuesEvicted() {
+    
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (__container_waves[i] == nullptr) // a container stays mapped, it costs no audio memory.
+            __pattern_audio_components[i]->SetSound(nullptr);
+    }
+    __bridge_audio_component->SetSound(nullptr);
+    __stinger_audio_component->SetSound(nullptr);
+    __bridge_sound_cues.Empty();
+    __stinger_sound_cues.Empty();
+    __cues_evicted = true;
+}
+
+double AAdaptiveMixer::__getAudioClock() {
+    
+    UWorld* world = GetWorld();
+    FAudioDevice* device = world ? world->GetAudioDevice() : nullptr;
+    return device ? device->GetAudioClock() : 0.0;
+}
+
+void AAdaptiveMixer::__recordControl(EMixerControlOp op, const TArray<float>& args, const FString& object_path) {
+    
+    if (!__control_log.IsRecording() || __control_nested)
+        return;
+    
+    __control_log.Record(op, GFrameCounter, __getAudioClock(), args, object_path);
+}
+
+void AAdaptiveMixer::__optimizeFilterChains() {
+    
+    TArray<UDynamicFilterChain*> chains = { __default_dynamic_filter_chain };
+    for (UScoreLayer* layer : __layers) {
+        chains.Add(layer->GetDynamicFilterChain());
+    }
+    
+    for (UDynamicFilterChain* chain : chains) {
+        FFilterChainReport report = chain->Optimize();
+        if (report.filters_after < report.filters_before) {
+            UE_LOG(AdaptiveMixerLog, Display, TEXT("%s: %d -> %d filters (%d invalid, %d shadowed, %d dead, %d fused)."),
+                *chain->GetName(), report.filters_before, report.filters_after, report.invalid_removed,
+                report.shadowed_removed, report.dead_removed, report.fused);
+        }
+    }
+}
+
+TArray<FFilterChainReport> AAdaptiveMixer::GetFilterChainReports() {
+    
+    TArray<FFilterChainReport> reports;
+    if (__default_dynamic_filter_chain != nullptr)
+        reports.Add(__default_dynamic_filter_chain->GetOptimizeReport());
+    for (UScoreLayer* layer : __layers) {
+        reports.Add(layer->GetDynamicFilterChain()->GetOptimizeReport());
+    }
+    return reports;
+}
+
+UScoreLayer* AAdaptiveMixer::__getLayer(int layer) {
+    
+    if ((layer < 0) || (layer >= __layers.Num())) {
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("There is no score layer %d."), layer);
+        return nullptr;
+    }
+    return __layers[layer];
+}
+
+void AAdaptiveMixer::__queueLayerChange(UScoreLayer* layer, bool active, uint8 texture, bool on_bar) {
+    
+    layer->QueueChange(active, texture);
+    
+    float bar = (__bar_length > 0.0f) ? __bar_length : __pattern_length;
+    if (!__is_running || !on_bar || (bar <= 0.0f)) {
+        __applyLayerChange(layer);
+        __decodeLayers(__score_fade_time);
+        return;
+    }
+    
+    // the first change arms the timer, the next ones wait for the same bar:
+    FTimerManager& timers = GetWorld()->GetTimerManager();
+    if (timers.IsTimerActive(__layer_bar_timer_handle))
+        return;
+    
+    float elapsed = GetWorld()->GetAudioTimeSeconds() - __transport_start_time;
+    float delay = bar - FMath::Fmod(elapsed, bar);
+    FTimerDelegate bar_timer_Del;
+    bar_timer_Del.BindUFunction(this, FName("__onLayerBarTimer"));
+    timers.SetTimer(__layer_bar_timer_handle, bar_timer_Del, FMath::Max(delay, KINDA_SMALL_NUMBER), false);
+}
+
+void AAdaptiveMixer::__applyLayerChange(UScoreLayer* layer) {
+    
+    if (!layer->ApplyPendingChange() || !__is_running)
+        return;
+    
+    if (layer->IsActive() && !layer->IsPlaying())
+        layer->Play(GetWorld()->GetAudioTimeSeconds() - __transport_start_time);
+    else if (!layer->IsActive() && layer->IsPlaying())
+        layer->Stop(__score_fade_time);
+}
+
+void AAdaptiveMixer::__decodeLayers(float fade) {
+    
+    if (!__is_running)
+        return;
+    
+    for (UScoreLayer* layer : __layers) {
+        if (layer->IsPlaying())
+            layer->Decode(layer->GetFilteredTexture(), __master_volume, fade);
+    }
+}
+
+void AAdaptiveMixer::__onLayerRealignTimer() {
+    
+    if (!__is_running)
+        return;
+    
+    for (UScoreLayer* layer : __layers) {
+        if (layer->IsActive() && !layer->IsPlaying())
+            layer->Play(GetWorld()->GetAudioTimeSeconds() - __transport_start_time);
+    }
+    __decodeLayers(RESTORE_FADE_TIME);
+}
+
+void AAdaptiveMixer::__onLayerBarTimer() {
+    
+    if (!__is_running)
+        return;
+    
+    for (UScoreLayer* layer : __layers) {
+        __applyLayerChange(layer);
+    }
+    __decodeLayers(__score_fade_time);
+}
+
+void AAdaptiveMixer::__routeDuckingSends() {
+    
+    // the previous score may have used another sidechain:
+    if (__ducking_submix != nullptr) {
+        __stinger_audio_component->SetSubmixSend(__ducking_submix, 0.0f);
+        __bridge_audio_component->SetSubmixSend(__ducking_submix, 0.0f);
+    }
+    
+    __ducking_submix = __loaded_score->GetDuckingSubmix();
+    if (__ducking_submix != nullptr) {
+        __stinger_audio_component->SetSubmixSend(__ducking_submix, 1.0f);
+        __bridge_audio_component->SetSubmixSend(__ducking_submix, 1.0f);
+    }
+}
+
+void AAdaptiveMixer::__startDucking() {
+    
+    if ((__ducking_submix == nullptr) || __ducking_active)
+        return;
+    
+    if (__fade_engine_stems == 0) {
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Score ducking needs stems on the fade engine (SetFadeEngine), ducking is off."));
+        return;
+    }
+    
+    FAudioDevice* device = GetWorld()->GetAudioDevice();
+    if (device == nullptr)
+        return;
+    
+    float attack = __loaded_score->GetDuckingAttack();
+    float release = __loaded_score->GetDuckingRelease();
+    float depth = __loaded_score->GetDuckingDepth();
+    if (__ducking_listener.IsValid())
+        __ducking_listener->Configure(attack, release, depth);
+    else
+        __ducking_listener = MakeShared<FStemDuckingListener, ESPMode::ThreadSafe>(__fade_engine, attack, release, depth);
+    
+    device->RegisterSubmixBufferListener(__ducking_listener.Get(), __ducking_submix);
+    __ducking_active = true;
+}
+
+void AAdaptiveMixer::__stopDucking() {
+    
+    if (!__ducking_active)
+        return;
+    
+    if (FAudioDevice* device = GetWorld()->GetAudioDevice())
+        device->UnregisterSubmixBufferListener(__ducking_listener.Get(), __ducking_submix);
+    __fade_engine->SetDuckGain(1.0f);
+    __ducking_active = false;
+}
+
+uint8 AAdaptiveMixer::__getFilteredTexture() {
+    
+    uint8 result = __filterTexture(__texture);
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("Processing texture with %s FCH..."),
+        __default_dynamic_filter_chain->IsAvailable() ? TEXT("Dynamic") : TEXT("Static"));
+    
+    if (FFilterChainProfiler::IsEnabled()) {
+        FFilterChainProfiler::Get().RecordFilterPass(__texture, result);
+        FFilterChainProfiler::Get().RecordTexture(this, __texture, GetWorld()->GetTimeSeconds());
+    }
+    return result;
+}
+
+uint8 AAdaptiveMixer::__filterTexture(uint8 texture) const {
+    
+    if (__default_dynamic_filter_chain->IsAvailable())
+        return __default_dynamic_filter_chain->ApplyDynamicFilterChain(texture);
+    else
+        return UStaticFilterChain::ApplyFilterChain(texture, __score_filterchain_index);
+}
+
+bool AAdaptiveMixer::__playTransitionPlan(uint8 from_texture, uint8 to_texture) {
+    
+    // intensity gains move on their own, other listeners aren't in the plan,
+    // and the profiler has to see every filter pass:
+    if (!__is_running || __intensity_mode || (__listener_set_count > 0) || FFilterChainProfiler::IsEnabled())
+        return false;
+    
+    uint8 valid_stems = 0;
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (__patterns_validation[i] == TRUE)
+            valid_stems |= 1 << i;
+    }
+    __transition_plans.Validate(__loaded_score, __score_filterchain_index,
+        __default_dynamic_filter_chain->GetRevision(), valid_stems, __patterns_volume);
+    
+    FTransitionPlan built;
+    const FTransitionPlan* plan = __transition_plans.Find(from_texture, to_texture);
+    if (plan == nullptr) {
+        built = __buildTransitionPlan(from_texture, to_texture);
+        plan = __transition_plans.Add(from_texture, to_texture, built);
+        if (plan == nullptr)
+            plan = &built;
+    }
+    
+    bool settled = __gains_settled && (__processed_texture == plan->from_processed);
+    __processed_texture = plan->to_processed;
+    
+    // the plan only knows the difference between two settled textures;
+    // layers don't depend on the main texture, they are left alone:
+    if (settled && (FStemVoiceBudget::Get().Request(this, plan->wanted, __pattern_priorities) == plan->wanted)) {
+        for (int i = 0; i < PTRN_COUNT; ++i) {
+            if (plan->changed & (1 << i))
+                __adjustPatternVolume(i, plan->gains[i], __score_fade_time);
+        }
+        return true;
+    }
+    
+    // a bridge, a budget drop or a restore left other gains behind, push them all:
+    float gains[PTRN_COUNT];
+    FMemory::Memcpy(gains, plan->gains, sizeof(gains));
+    __applyVoiceBudget(gains, __score_fade_time, true);
+    __pushPatternGains(gains, __score_fade_time);
+    __decodeLayers(__score_fade_time);
+    __gains_settled = (__budget_dropped == 0);
+    return true;
+}
+
+FTransitionPlan AAdaptiveMixer::__buildTransitionPlan(uint8 from_texture, uint8 to_texture) const {
+    
+    FTransitionPlan plan;
+    plan.from_processed = __filterTexture(from_texture);
+    plan.to_processed = __filterTexture(to_texture);
+    plan.wanted = 0;
+    plan.changed = 0;
+    
+    bool from_b[PTRN_COUNT];
+    bool to_b[PTRN_COUNT];
+    UStaticFilterChain::BoolArrayFromByte(plan.from_processed, from_b);
+    UStaticFilterChain::BoolArrayFromByte(plan.to_processed, to_b);
+    
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        plan.gains[i] = (to_b[i]) ? (__patterns_volume[i]) : 0.0f;
+        float from_gain = (from_b[i]) ? (__patterns_volume[i]) : 0.0f;
+        if ((plan.gains[i] > 0.0f) && (__patterns_validation[i] == TRUE))
+            plan.wanted |= 1 << i;
+        if (plan.gains[i] != from_gain)
+            plan.changed |= 1 << i;
+    }
+    return plan;
+}
+
+void AAdaptiveMixer::__initializeDefaultVolume() {
+    
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        __patterns_volume[i] = 1.0f;
+    }
+}
+
+void AAdaptiveMixer::__onBridgeCrossfadeTimer(float fade) {
+    
+    if (!__is_running)
+        return; 
+    
+    __bridge_pending = false;
+    __beginToPlaySilently();
+    __decodeFromByte(__getFilteredTexture(), fade);
+    __bridge_audio_component->FadeOut(fade, 0.0f);
+    
+    // the bridge lands when the patterns are back, not on a timer of its own:
+    for (FMixerPendingTransition& t : __pending_transitions) {
+        if (t.kind == EMixerTransition::Bridge)
+            t.land_time = GetWorld()->GetAudioTimeSeconds() + fade;
+    }
+}
+
+void AAdaptiveMixer::__onTextureRulesTimer() {
+    
+    if (!__is_running)
+        return;
+    
+    if (!__default_texture_rule_set->IsAvailable())
+        return;
+    
+    uint8 ruled_texture = __default_texture_rule_set->Evaluate(__texture, GetWorld()->GetTimeSeconds());
+    if (ruled_texture != __texture)
+        PlayNewTexture(ruled_texture);
+}
+
+void AAdaptiveMixer::__onArbitrationTimer() {
+    
+    if (!__is_running)
+        return;
+    
+    if (!__default_texture_arbiter->IsDirty())
+        return;
+    
+    uint8 resolved_texture = __default_texture_arbiter->Resolve(GetWorld()->GetTimeSeconds());
+    if (resolved_texture != __texture)
+        PlayNewTexture(resolved_texture);
+}
+
+void AAdaptiveMixer::__muteTrack(uint8 index, float fade) {
+    
+    if (__patterns_validation[index] == TRUE) {
+        if (__isOnFadeEngine(index))
+            __fade_engine->SetTarget(index, 0.0f, fade, __latency_token);
+        else
+            __pattern_audio_components[index]->FadeOut(fade, 0.0f);
+        __latency_on_render |= __isOnFadeEngine(index);
+        __latency_on_audio_thread |= !__isOnFadeEngine(index);
+    }
+    __applied_gains[index] = 0.0f;
+    __gains_settled = false;
+}
+
+float AAdaptiveMixer::__verifiedVolume(float volume) {
+    
+    if (volume < 0.0f)
+        return 0.0f;
+    else if (volume > 1.0f)
+        return 1.0f;
+    else
+        return volume;
+}
+
+void AAdaptiveMixer::__adjustPatternVolume(uint8 index, float volume, float fade) {
+    
+    if (__patterns_validation[index] == TRUE) {
         
+        if (__isOnFadeEngine(index))
+            __fade_engine->SetTarget(index, volume * __master_volume, fade, __latency_token); // just a queue push.
+        else
+            __pattern_audio_components[index]->AdjustVolume(fade, volume * __master_volume);
+        __latency_on_render |= __isOnFadeEngine(index);
+        __latency_on_audio_thread |= !__isOnFadeEngine(index);
+    }
+    __applied_gains[index] = volume * __master_volume;
+}
+
+void AAdaptiveMixer::__decodeFromByte(uint8 processed_texture, float fade) {
+    
+    if (!__is_running)
+        return;
+    
+    __processed_texture = processed_texture;
+    
+    float gains[PTRN_COUNT];
+    __computePatternGains(processed_texture, gains);
+    __applyVoiceBudget(gains, fade, true);
+    __pushPatternGains(gains, fade);
+    __gains_settled = !__intensity_mode && (__budget_dropped == 0);
+    __decodeLayers(fade);
+}
+
+void AAdaptiveMixer::__applyVoiceBudget(float gains[PTRN_COUNT], float fade, bool request) {
+    
+    uint8 wanted = 0;
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if ((gains[i] > 0.0f) && (__patterns_validation[i] == TRUE))
+            wanted |= 1 << i;
+    }
+    
+    uint8 granted = request ? FStemVoiceBudget::Get().Request(this, wanted, __pattern_priorities)
+                            : FStemVoiceBudget::Get().GetGranted(this);
+    uint8 dropped = wanted & uint8(~granted);
+    
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (dropped & (1 << i))
+            gains[i] = 0.0f;
+    }
+    
+    // the fade engine mutes inside the source effect, so the voice itself
+    // must go silent too, or it can't be virtualized:
+    if (__fade_engine_stems != 0) {
+        uint8 toggled = (dropped ^ __budget_dropped) & __fade_engine_stems;
+        for (int i = 0; i < PTRN_COUNT; ++i) {
+            if ((toggled & (1 << i)) && (__patterns_validation[i] == TRUE))
+                __pattern_audio_components[i]->AdjustVolume(fade, (dropped & (1 << i)) ? 0.0f : 1.0f);
+        }
+    }
+    __budget_dropped = dropped;
+}
+
+void AAdaptiveMixer::OnVoiceBudgetChanged() {
+    
+    if (!__is_running)
+        return;
+    
+    float gains[PTRN_COUNT];
+    __computePatternGains(__processed_texture, gains);
+    __applyVoiceBudget(gains, __score_fade_time, false);
+    __pushPatternGains(gains, __score_fade_time);
+    __gains_settled = !__intensity_mode && (__budget_dropped == 0);
+}
+
+void AAdaptiveMixer::__computePatternGains(uint8 processed_texture, float gains[PTRN_COUNT]) {
+    
+    bool b[PTRN_COUNT];
+    UStaticFilterChain::BoolArrayFromByte(processed_texture, b);
+    
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        gains[i] = (b[i]) ? (__patterns_volume[i]) : 0.0f;
+    }
+    
+    for (int l = 1; (l < MAX_LISTENER_SETS) && (__listener_set_count > 0); ++l) {
+        if (__listener_sets[l].used)
+            __listener_sets[l].MaxGains(__filterTexture(__listener_sets[l].texture), gains);
+    }
+    
+    if (__intensity_mode) {
+        float intensity[PTRN_COUNT];
+        __default_intensity_vector->Evaluate(intensity);
+        for (int i = 0; i < PTRN_COUNT; ++i) {
+            gains[i] *= intensity[i];
+        }
+    }
+}
+
+void AAdaptiveMixer::__pushPatternGains(const float gains[PTRN_COUNT], float fade) {
+    
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (FMath::Abs(gains[i] * __master_volume - __applied_gains[i]) > GAIN_EPSILON) {
+            __adjustPatternVolume(i, gains[i], fade);
+        }
+    }
+}
+
+void AAdaptiveMixer::__beginToPlaySilently(float start_time) {
+    
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (__patterns_validation[i] == TRUE) {
+            // primed by Prepare at 0 it just goes on; restarted elsewhere it would stay paused:
+            if (__prepared)
+                __pattern_audio_components[i]->SetPaused(false);
+            if (__prepared && (start_time == 0.0f))
+                continue;
+            if (__container_waves[i] != nullptr) {
+                __container_waves[i]->SeekTo(start_time);
+                __pattern_audio_components[i]->Play(0.0f);
+            }
+            else {
+                __pattern_audio_components[i]->Play(start_time);
+            }
+        }
+    }
+    __prepared = false;
+    float previous_position = GetWorld()->GetAudioTimeSeconds() - __transport_start_time;
+    __transport_start_time = GetWorld()->GetAudioTimeSeconds() - start_time;
+    
+    // layers follow the transport (after a bridge too, onto the new downbeat). One that is
+    // heard and out of phase fades out and comes back on the new transport, no hard restart:
+    bool realign = false;
+    for (UScoreLayer* layer : __layers) {
+        if (!layer->IsActive())
+            continue;
+        if (!layer->IsPlaying()) {
+            layer->Play(start_time);
+            continue;
+        }
+        float loop = layer->GetLoopLength();
+        float drift = (loop > 0.0f) ? FMath::Abs(FMath::Fmod(previous_position, loop) - FMath::Fmod(start_time, loop)) : loop;
+        if ((loop <= 0.0f) || (FMath::Min(drift, loop - drift) > LAYER_PHASE_TOLERANCE)) {
+            layer->Stop(RESTORE_FADE_TIME);
+            realign = true;
+        }
+    }
+    if (realign) {
+        FTimerDelegate realign_timer_Del;
+        realign_timer_Del.BindUFunction(this, FName("__onLayerRealignTimer"));
+        GetWorld()->GetTimerManager().SetTimer(__layer_realign_timer_handle, realign_timer_Del, RESTORE_FADE_TIME, false);
+    }
+    __budget_dropped = 0; // Play() brings every voice back to volume 1.
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        __adjustPatternVolume(i, 0.0f, 0.0f);
+    }
+    __gains_settled = false;
+}
+
+int AAdaptiveMixer::AddListenerSet(uint8 initial_texture) {
+    
+    __recordControl(EMixerControlOp::AddListenerSet, { float(initial_texture) });
+    
+    for (int l = 1; l < MAX_LISTENER_SETS; ++l) {
+        if (!__listener_sets[l].used) {
+            __listener_sets[l] = FListenerGainSet();
+            __listener_sets[l].used = true;
+            __listener_sets[l].texture = initial_texture;
+            ++__listener_set_count;
+            __decodeListenerChange();
+            return l;
+        }
+    }
+    UE_LOG(AdaptiveMixerLog, Warning, TEXT("All %d listener sets are taken."), MAX_LISTENER_SETS);
+    return -1;
+}
+
+void AAdaptiveMixer::RemoveListenerSet(int listener) {
+    
+    __recordControl(EMixerControlOp::RemoveListenerSet, { float(listener) });
+    
+    FListenerGainSet* set = __getListenerSet(listener);
+    if (set == nullptr)
+        return;
+    
+    set->used = false;
+    --__listener_set_count;
+    __decodeListenerChange();
+}
+
+void AAdaptiveMixer::SetListenerTexture(int listener, uint8 new_texture) {
+    
+    __recordControl(EMixerControlOp::SetListenerTexture, { float(listener), float(new_texture) });
+    
+    FListenerGainSet* set = __getListenerSet(listener);
+    if ((set == nullptr) || (set->texture == new_texture))
+        return;
+    
+    set->texture = new_texture;
+    __decodeListenerChange();
+}
+
+void AAdaptiveMixer::SetListenerPatternVolume(int listener, uint8 index, float volume) {
+    
+    __recordControl(EMixerControlOp::SetListenerPatternVolume, { float(listener), float(index), volume });
+    
+    FListenerGainSet* set = __getListenerSet(listener);
+    if ((set == nullptr) || (index >= PTRN_COUNT))
+        return;
+    
+    set->volumes[index] = __verifiedVolume(volume);
+    __decodeListenerChange();
+}
+
+int AAdaptiveMixer::GetListenerSetCount() {
+    return __listener_set_count + 1; // the mixer's own
+}
+
+FListenerGainSet* AAdaptiveMixer::__getListenerSet(int listener) {
+    
+    if ((listener < 1) || (listener >= MAX_LISTENER_SETS) || !__listener_sets[listener].used) {
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("No listener set %d."), listener);
+        return nullptr;
+    }
+    return &__listener_sets[listener];
+}
+
+void AAdaptiveMixer::__decodeListenerChange() {
+    
+    // under a bridge the patterns are muted, the crossfade decodes every set:
+    if (__bridge_pending)
+        return;
+    __decodeFromByte(__processed_texture, __score_fade_time);
+}
+
+TFuture<bool> AAdaptiveMixer::RunAsync(uint8 initial_texture) {
+    
+    TSharedRef<TPromise<bool>> promise = MakeShared<TPromise<bool>>();
+    TFuture<bool> future = promise->GetFuture();
+    RunAndNotify(initial_texture, [promise](bool landed) { promise->SetValue(landed); });
+    return future;
+}
+
+TFuture<bool> AAdaptiveMixer::PlayNewTextureAfterBridgeAsync(uint8 new_texture, int bridge_index,
+    float fade_out_ratio, float fade_in_ratio, float bridge_volume) {
+    
+    TSharedRef<TPromise<bool>> promise = MakeShared<TPromise<bool>>();
+    TFuture<bool> future = promise->GetFuture();
+    PlayNewTextureAfterBridgeAndNotify(new_texture, bridge_index, fade_out_ratio, fade_in_ratio, bridge_volume,
+        [promise](bool landed) { promise->SetValue(landed); });
+    return future;
+}
+
+TFuture<bool> AAdaptiveMixer::PlayStingerAsync(int index, float stinger_volume) {
+    
+    TSharedRef<TPromise<bool>> promise = MakeShared<TPromise<bool>>();
+    TFuture<bool> future = promise->GetFuture();
+    PlayStingerAndNotify(index, stinger_volume, [promise](bool landed) { promise->SetValue(landed); });
+    return future;
+}
+
+void AAdaptiveMixer::RunAndNotify(uint8 initial_texture, TFunction<void(bool)> on_landed) {
+    
+    uint32 serial_before = __run_serial;
+    Run(initial_texture);
+    __awaitTransition(EMixerTransition::Run, serial_before,
+        GetWorld()->GetAudioTimeSeconds() + __score_fade_time, MoveTemp(on_landed));
+}
+
+void AAdaptiveMixer::PlayNewTextureAfterBridgeAndNotify(uint8 new_texture, int bridge_index,
+    float fade_out_ratio, float fade_in_ratio, float bridge_volume, TFunction<void(bool)> on_landed) {
+    
+    // lands when __onBridgeCrossfadeTimer has brought the patterns back:
+    uint32 serial_before = __bridge_serial;
+    PlayNewTextureAfterBridge(new_texture, bridge_index, fade_out_ratio, fade_in_ratio, bridge_volume);
+    __awaitTransition(EMixerTransition::Bridge, serial_before, TNumericLimits<float>::Max(), MoveTemp(on_landed));
+}
+
+void AAdaptiveMixer::PlayStingerAndNotify(int index, float stinger_volume, TFunction<void(bool)> on_landed) {
+    
+    uint32 serial_before = __stinger_serial;
+    PlayStinger(index, stinger_volume);
+    float duration = (__stinger_serial != serial_before) ? __stinger_audio_component->Sound->GetDuration() : 0.0f;
+    __awaitTransition(EMixerTransition::Stinger, serial_before,
+        GetWorld()->GetAudioTimeSeconds() + duration, MoveTemp(on_landed));
+}
+
+uint32 AAdaptiveMixer::__transitionSerial(EMixerTransition kind) const {
+    
+    switch (kind) {
+        case EMixerTransition::Run:
+            return __run_serial;
+        case EMixerTransition::Bridge:
+            return __bridge_serial;
+        default:
+            return __stinger_serial;
+    }
+}
+
+void AAdaptiveMixer::__awaitTransition(EMixerTransition kind, uint32 serial_before, float land_time,
+    TFunction<void(bool)> on_landed) {
+    
+    uint32 serial = __transitionSerial(kind);
+    if (serial == serial_before) { // didn't start (not running, bad index, a client replica...)
+        on_landed(false);
+        return;
+    }
+    __pending_transitions.Add({ kind, serial, land_time, MoveTemp(on_landed) });
+    SetActorTickEnabled(true);
+}
+
+void AAdaptiveMixer::__completeTransitions() {
+    
+    float now = GetWorld()->GetAudioTimeSeconds();
+    
+    // collected first: a callback may Stop, Run or start new transitions,
+    // all of which change __pending_transitions.
+    TArray<TPair<TFunction<void(bool)>, bool>> finished;
+    for (int i = __pending_transitions.Num() - 1; i >= 0; --i) {
+        FMixerPendingTransition& t = __pending_transitions[i];
+        bool cut_off = (t.serial != __transitionSerial(t.kind));
+        if (cut_off || (now >= t.land_time)) {
+            finished.Emplace(MoveTemp(t.on_landed), !cut_off);
+            __pending_transitions.RemoveAtSwap(i);
+        }
+    }
+    if (__pending_transitions.Num() == 0)
+        SetActorTickEnabled(false);
+    
+    for (TPair<TFunction<void(bool)>, bool>& f : finished) {
+        f.Key(f.Value);
+    }
+}
+
+void AAdaptiveMixer::__cancelTransitions() {
+    
+    TArray<FMixerPendingTransition> cancelled = MoveTemp(__pending_transitions);
+    __pending_transitions.Reset();
+    SetActorTickEnabled(false);
+    for (FMixerPendingTransition& t : cancelled) {
+        t.on_landed(false);
+    }
+}
+
+void AAdaptiveMixer::Tick(float DeltaSeconds) {
+    
+    Super::Tick(DeltaSeconds);
+    __completeTransitions();
+}
+
+void AAdaptiveMixer::SetStateReplication(bool enabled) {
+    
+    if (!HasAuthority()) {
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Mixer replication can only be switched on the server."));
+        return;
+    }
+    bAlwaysRelevant = enabled; // music is heard everywhere.
+    SetReplicates(enabled);
+}
+
+bool AAdaptiveMixer::RegisterReplicatedScore(UAdaptiveScore* score, int score_id) {
+    
+    if ((score_id < 1) || (score_id > MAX_uint16)) {
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Score id %d is out of range (1..65535)."), score_id);
+        return false;
+    }
+    return FMixerReplication::RegisterScore(GetWorld(), score, uint16(score_id));
+}
+
+void AAdaptiveMixer::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const {
+    
+    Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+    DOREPLIFETIME(AAdaptiveMixer, __rep_texture);
+    DOREPLIFETIME(AAdaptiveMixer, __rep_transport);
+    DOREPLIFETIME(AAdaptiveMixer, __rep_server_audio_time);
+}
+
+void AAdaptiveMixer::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) {
+    
+    Super::PreReplication(ChangedPropertyTracker);
+    
+    __rep_texture = __texture;
+    __rep_transport.running = __is_running;
+    __rep_transport.score_id = __is_initialized ? FMixerReplication::FindScoreId(GetWorld(), __loaded_score) : 0;
+    
+    // the anchor only moves when the transport restarts, the clock sample once per interval:
+    float now = GetWorld()->GetAudioTimeSeconds();
+    if (__is_running)
+        __rep_transport.start_audio_time = __transport_start_time;
+    if (now - __rep_server_audio_time >= SERVER_CLOCK_INTERVAL)
+        __rep_server_audio_time = now;
+}
+
+void AAdaptiveMixer::__onRepServerClock() {
+    
+    // the sample is half a round trip old when it gets here:
+    float server_now = __rep_server_audio_time + FMixerReplication::GetOneWayLatency(GetWorld());
+    __server_clock_offset = server_now - GetWorld()->GetAudioTimeSeconds();
+    __server_clock_valid = true;
+    
+    TGuardValue<bool> replication_guard(__applying_replication, true);
+    __seekToServerTransport();
+}
+
+void AAdaptiveMixer::__onRepTexture() {
+    
+    TGuardValue<bool> replication_guard(__applying_replication, true);
+    if (__is_running)
+        PlayNewTexture(__rep_texture);
+    else
+        __texture = __rep_texture;
+}
+
+void AAdaptiveMixer::__onRepTransport() {
+    
+    TGuardValue<bool> replication_guard(__applying_replication, true);
+    
+    if (__rep_transport.score_id != FMixerReplication::FindScoreId(GetWorld(), __is_initialized ? __loaded_score : nullptr)) {
+        UAdaptiveScore* score = FMixerReplication::FindScore(GetWorld(), __rep_transport.score_id);
+        if (score == nullptr) {
+            UE_LOG(AdaptiveMixerLog, Warning, TEXT("Replicated score id %d is not registered here."), __rep_transport.score_id);
+            return;
+        }
+        Stop();
+        if (!InitializeMixer(score, __is_initialized ? __master_volume : 1.0f))
+            return;
+    }
+    
+    if (!__rep_transport.running) {
+        Stop();
+        return;
+    }
+    
+    if (!__is_running)
+        Run(__rep_texture);
+    __seekToServerTransport();
+}
+
+void AAdaptiveMixer::__seekToServerTransport() {
+    
+    // a bridge restarts the transport when it lands, the server sends the new anchor then:
+    if (!__is_running || __bridge_pending || !__server_clock_valid || !__rep_transport.running)
+        return;
+    
+    // both positions on the audio clock, the server's one through the synced offset:
+    float local_now = GetWorld()->GetAudioTimeSeconds();
+    float server_position = local_now + __server_clock_offset - __rep_transport.start_audio_time;
+    float local_position = local_now - __transport_start_time;
+    float drift = FMath::Abs(server_position - local_position);
+    if (__pattern_length > 0.0f) {
+        server_position = FMath::Fmod(FMath::Max(server_position, 0.0f), __pattern_length);
+        drift = FMath::Fmod(drift, __pattern_length);
+        drift = FMath::Min(drift, __pattern_length - drift);
+    }
+    
+    if (drift <= FMixerReplication::GetSeekTolerance())
+        return;
+    
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("Client mixer %.3f s off the server, seeking to %.3f s."), drift, server_position);
+    __beginToPlaySilently(server_position);
+    __decodeFromByte(__getFilteredTexture(), RESTORE_FADE_TIME);
+}
+
+void AAdaptiveMixer::__multicastBridge_Implementation(uint8 new_texture, FMixerPackedIndex bridge_index,
+    uint8 fade_out_ratio, uint8 fade_in_ratio, uint8 bridge_volume) {
+    
+    if (HasAuthority())
+        return;
+    
+    TGuardValue<bool> replication_guard(__applying_replication, true);
+    PlayNewTextureAfterBridge(new_texture, int(bridge_index.value), FMixerReplication::Dequantize(fade_out_ratio),
+        FMixerReplication::Dequantize(fade_in_ratio), FMixerReplication::Dequantize(bridge_volume));
+}
+
+void AAdaptiveMixer::__multicastStinger_Implementation(FMixerPackedIndex index, uint8 stinger_volume) {
+    
+    if (HasAuthority())
+        return;
+    
+    TGuardValue<bool> replication_guard(__applying_replication, true);
+    PlayStinger(int(index.value), FMixerReplication::Dequantize(stinger_volume));
+}
+
+bool AAdaptiveMixer::__isReplicationServer() const {
+    return GetIsReplicated() && HasAuthority();
+}
+
+bool AAdaptiveMixer::__ignoresLocalControl() const {
+    return GetIsReplicated() && !HasAuthority() && !__applying_replication;
+}
+
+void AAdaptiveMixer::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+    
+    TGuardValue<bool> replication_guard(__applying_replication, true); // replicas stop too.
+    Stop();
+    FStemCache::Get().Unregister(this);
+    __unregisterFadeEngine();
+    Super::EndPlay(EndPlayReason);
+}
+
+void AAdaptiveMixer::BeginDestroy() {
+    
+    __unregisterFadeEngine(); // a mixer that never began play, e.g. in the editor.
+    Super::BeginDestroy();
+}
+
+void AAdaptiveMixer::__unregisterFadeEngine() {
+    
+    if (!__fade_engine_enabled)
+        return;
+    
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (__pattern_audio_components[i] != nullptr)
+            FStemFadeEngine::Unregister(__pattern_audio_components[i]->GetAudioComponentID());
+    }
+    __fade_engine_enabled = false;
+    __fade_engine_stems = 0;
+}
+
+AAdaptiveMixer::~AAdaptiveMixer() {
+    
     UE_LOG(AdaptiveMixerLog, Display, TEXT("Adaptive mixer destroyed."));
 }
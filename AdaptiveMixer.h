@@ -4,11 +4,31 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "MixerConstants.h"
 #include "TimerManager.h"
 #include "Components/AudioComponent.h"
 #include "Sound/SoundCue.h"
 #include "AdaptiveScore.h"
 #include "FilterChain.h"
+#include "IntensityVector.h"
+#include "TextureRules.h"
+#include "MixerCommandBatch.h"
+#include "MixerControlLog.h"
+#include "StemFadeEngine.h"
+#include "StemDucking.h"
+#include "VoiceBudget.h"
+#include "StemCache.h"
+#include "FilterChainProfiler.h"
+#include "StemContainer.h"
+#include "TextureArbiter.h"
+#include "MixerSnapshot.h"
+#include "ScoreLayer.h"
+#include "TransitionPlanCache.h"
+#include "MixerReplication.h"
+#include "MixerAsync.h"
+#include "ListenerGainSet.h"
+#include "ControlLatency.h"
+#include "Async/Future.h"
 #include "AdaptiveMixer.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(AdaptiveMixerLog, Log, All);
@@ -16,8 +36,6 @@ DECLARE_LOG_CATEGORY_EXTERN(AdaptiveMixerLog, Log, All);
 constexpr uint8 FALSE = 0;
 constexpr uint8 TRUE = 1;
 
-constexpr uint8 PTRN_COUNT = 8;
-
 UCLASS(Blueprintable)
 class AAdaptiveMixer : public AActor
 {
@@ -44,6 +62,17 @@ class AAdaptiveMixer : public AActor
                                              // another way -- type your own filter chain function
                                              // in FilterChain.cpp and recompile.
                                         
+    UFUNCTION(BlueprintCallable)        TArray<FFilterChainReport> GetFilterChainReports();
+                                        // What Run / Prepare's chain optimization did:
+                                        // the default chain first, then one per layer.
+                                        
+    UFUNCTION(BlueprintCallable)   /*Step 3.9*/ bool Prepare(const TArray<int>& bridge_indices);
+                                             // Optional, a moment before Run: starts every stem
+                                             // paused at volume 0 so its decoder has buffers
+                                             // ready, and precaches the bridges likely to come
+                                             // (all of them when the array is empty).
+                                             // Run then only unpauses the stems.
+                                        
     UFUNCTION(BlueprintCallable)   /*Step 4*/   void Run(uint8 initial_texture);
     
     UFUNCTION(BlueprintCallable)        void Stop();
@@ -51,6 +80,10 @@ class AAdaptiveMixer : public AActor
     UFUNCTION(BlueprintCallable)        bool IsRunning();
     UFUNCTION(BlueprintCallable)        bool IsInitialized();
     UFUNCTION(BlueprintCallable)        uint8 GetTexture();
+    UFUNCTION(BlueprintCallable)        float GetPlaybackPosition(); // seconds into the pattern loop.
+    UFUNCTION(BlueprintCallable)        bool IsPrepared();
+    UFUNCTION(BlueprintCallable)        float GetStartLatency();        // ms from Run / the bridge call to
+    UFUNCTION(BlueprintCallable)        float GetBridgeStartLatency();  // its first rendered buffer, -1 = none yet.
     
     // P L A Y B A C K  M A N A G E M E N T :
     
@@ -78,6 +111,25 @@ class AAdaptiveMixer : public AActor
     UFUNCTION(BlueprintCallable)        void BitwiseANDing(uint8 mask);
                                         // Useful to eject more than 1 patterns.
 
+    // W A I T I N G  F O R  T R A N S I T I O N S :
+    // Blueprint: RunAndWait, PlayNewTextureAfterBridgeAndWait, PlayStingerAndWait (MixerAsync.h).
+    
+                                        TFuture<bool> RunAsync(uint8 initial_texture);
+                                        TFuture<bool> PlayNewTextureAfterBridgeAsync(uint8 new_texture,
+                                        int bridge_index, float fade_out_ratio, float fade_in_ratio,
+                                        float bridge_volume = 1.0f);
+                                        TFuture<bool> PlayStingerAsync(int index, float stinger_volume = 1.0f);
+                                        // true when the transition has landed on the audio clock,
+                                        // false when it couldn't start or was cut off.
+                                        
+                                        void RunAndNotify(uint8 initial_texture, TFunction<void(bool)> on_landed);
+                                        void PlayNewTextureAfterBridgeAndNotify(uint8 new_texture,
+                                        int bridge_index, float fade_out_ratio, float fade_in_ratio,
+                                        float bridge_volume, TFunction<void(bool)> on_landed);
+                                        void PlayStingerAndNotify(int index, float stinger_volume,
+                                        TFunction<void(bool)> on_landed);
+                                        // Same, called on the game thread from the mixer's tick.
+    
     // V O L U M E  M A N A G E M E N T :
     
     UFUNCTION(BlueprintCallable)        void SetPatternVolume(uint8 index, float volume = 1.0f);
@@ -89,6 +141,125 @@ class AAdaptiveMixer : public AActor
                                         float ptrn7_vol = 1.0f, bool adjust_playback = false);
     UFUNCTION(BlueprintCallable)        void SetMasterVolume(float volume = 1.0f);
     
+    UFUNCTION(BlueprintCallable)        void ApplyCommandBatch(const FMixerCommandBatch& batch);
+                                        // Texture ops, volumes and stinger in one call,
+                                        // one filter pass and one decode.
+    
+    // I N T E N S I T Y  V E C T O R :
+    
+    UFUNCTION(BlueprintCallable)        UIntensityVector* GetIntensityVector();
+                                        // Set per-pattern response curves here
+                                        // (UIntensityVector::SetResponseCurve).
+    UFUNCTION(BlueprintCallable)        void SetIntensityMode(bool enabled, float smoothing_time = 0.1f);
+                                        // When enabled, each active pattern plays at
+                                        // pattern_volume * curve(parameter) instead of
+                                        // fully on. The texture still decides which
+                                        // patterns are active.
+    UFUNCTION(BlueprintCallable)        void SetIntensity(uint8 parameter, float value);
+                                        // Cheap: no filter chain, only stems whose gain
+                                        // really changed are sent to audio.
+    
+    // A R B I T R A T I O N :
+    
+    UFUNCTION(BlueprintCallable)        UTextureArbiter* GetTextureArbiter();
+                                        // Gameplay systems send named requests here
+                                        // (UTextureArbiter::Request / Release) instead of
+                                        // calling PlayNewTexture on their own.
+    UFUNCTION(BlueprintCallable)        void StartTextureArbitration(float min_transition_interval = 0.25f);
+                                        // Requests are resolved into one texture at most once
+                                        // per interval, a pile-up becomes a single transition.
+    UFUNCTION(BlueprintCallable)        void StopTextureArbitration();
+    
+    // A U D I O - T H R E A D  F A D E S :
+    
+    UFUNCTION(BlueprintCallable)        void SetFadeEngine(bool enabled, FString curve = TEXT("equal_power"),
+                                        UCurveFloat* custom_curve = nullptr);
+                                        // Stem fades run on the audio render thread instead of
+                                        // AdjustVolume ramps. Curve: "linear", "equal_power",
+                                        // "s_curve" or "custom" (custom_curve, 0..1 -> 0..1).
+                                        // Pattern cues need UStemGainSourcePreset in their
+                                        // source effect chain; stems without it (and stem
+                                        // container waves) keep the AdjustVolume ramps.
+    
+    // T E X T U R E  R U L E S :
+    
+    UFUNCTION(BlueprintCallable)        UTextureRuleSet* GetTextureRuleSet();
+                                        // Map named game parameters to texture bits
+                                        // (UTextureRuleSet::AddFloatRule / AddBoolRule),
+                                        // then feed it with SetFloatParameter / SetBoolParameter.
+    UFUNCTION(BlueprintCallable)        void StartTextureRules(float rate_hz = 10.0f);
+                                        // Rules are evaluated rate_hz times per second,
+                                        // PlayNewTexture is called only if the result differs.
+    UFUNCTION(BlueprintCallable)        void StopTextureRules();
+    
+    // S N A P S H O T :
+    
+    UFUNCTION(BlueprintCallable)        FMixerSnapshot CaptureSnapshot();
+    UFUNCTION(BlueprintCallable)        bool RestoreSnapshot(const FMixerSnapshot& snapshot);
+                                        // One step: re-initializes only if the score differs,
+                                        // seeks every stem to the saved position (or resumes
+                                        // the pending bridge) and restores all volumes.
+                                        // Client replicas follow the server, false there.
+    
+    // L A Y E R S :
+    
+    UFUNCTION(BlueprintCallable)        int AddScoreLayer(UAdaptiveScore* score, float layer_volume = 1.0f);
+                                        // Another score on the transport of this one (e.g. combat
+                                        // over ambient). Returns the layer index, -1 on failure.
+    UFUNCTION(BlueprintCallable)        void RemoveScoreLayer(int layer); // later layers move down by one.
+    UFUNCTION(BlueprintCallable)        UDynamicFilterChain* GetLayerFilterChain(int layer);
+    UFUNCTION(BlueprintCallable)        void StartLayer(int layer, uint8 initial_texture, bool on_bar = true);
+    UFUNCTION(BlueprintCallable)        void StopLayer(int layer, bool on_bar = true);
+    UFUNCTION(BlueprintCallable)        void SetLayerTexture(int layer, uint8 new_texture, bool on_bar = true);
+                                        // on_bar: wait for the next bar of the transport.
+                                        // All layer changes due on the same bar go through
+                                        // one decode pass.
+    UFUNCTION(BlueprintCallable)        void SetLayerVolume(int layer, float volume = 1.0f);
+    UFUNCTION(BlueprintCallable)        void SetBarLength(float seconds);
+                                        // Grid for on_bar changes, 0 (default) = the pattern loop.
+    UFUNCTION(BlueprintCallable)        int GetLayerCount();
+    
+    // S P L I T - S C R E E N  L I S T E N E R S :
+    
+    UFUNCTION(BlueprintCallable)        int AddListenerSet(uint8 initial_texture = 0);
+                                        // One more local player on this mixer, with a texture
+                                        // and pattern volumes of its own. Listener 0 is the
+                                        // mixer itself (PlayNewTexture, SetPatternVolume).
+                                        // Stems are decoded once and play at the loudest gain
+                                        // any listener asks for; there is one output device,
+                                        // so every player hears that mix.
+                                        // Returns the listener index, -1 when all are taken.
+    UFUNCTION(BlueprintCallable)        void RemoveListenerSet(int listener); // other indices stay.
+    UFUNCTION(BlueprintCallable)        void SetListenerTexture(int listener, uint8 new_texture);
+    UFUNCTION(BlueprintCallable)        void SetListenerPatternVolume(int listener, uint8 index, float volume = 1.0f);
+    UFUNCTION(BlueprintCallable)        int GetListenerSetCount();
+    
+    // R E C O R D  &  R E P L A Y :
+    
+    UFUNCTION(BlueprintCallable)        void StartControlRecording();
+                                        // Logs every public control call with frame
+                                        // and audio clock timestamps (what is left out:
+                                        // see MixerControlLog.h).
+    UFUNCTION(BlueprintCallable)        bool StopControlRecording(FString file_path);
+    
+                                        void ReplayControlEvent(const FMixerControlEvent& event);
+                                        // Re-drives one logged call (used by the headless replay).
+    
+    // R E P L I C A T I O N :
+    
+    UFUNCTION(BlueprintCallable)        void SetStateReplication(bool enabled);
+                                        // Server only. Texture, score, transport position,
+                                        // bridges and stingers are sent to every client;
+                                        // client mixers follow and ignore their own control
+                                        // calls (volumes stay local). The mixer must be
+                                        // spawned by the server. Test it in PIE with two
+                                        // players and "Play As Listen Server".
+                                        // Filter chains are not replicated, set them up
+                                        // the same way on every machine.
+    UFUNCTION(BlueprintCallable)        bool RegisterReplicatedScore(UAdaptiveScore* score, int score_id);
+                                        // Same id (1..65535) for the same score on every machine.
+                                        // Ids are per world, so a listen server and a client in one process don't collide.
+    
     // A D V A N C E D  M A T H S :
     
     UFUNCTION(BlueprintCallable)        uint8 BinaryToDecimal(int binary_number);// Just type in binary.
@@ -162,8 +333,12 @@ GO@MMBMOMMMM@MOGGZMO8GGEZGMMBB@B@@@BO2MOO8@B@B@@@B@B@@@B@B@B@@@Br 7B::;7rriB@B@B
 
         UPROPERTY()         UAdaptiveScore* __default_adaptive_score;   
         UPROPERTY()         UDynamicFilterChain* __default_dynamic_filter_chain;    
+        UPROPERTY()         UIntensityVector* __default_intensity_vector;
+        UPROPERTY()         UTextureRuleSet* __default_texture_rule_set;
+        UPROPERTY()         UTextureArbiter* __default_texture_arbiter;
     
         UPROPERTY()         UAudioComponent* __pattern_audio_components[PTRN_COUNT];    
+        UPROPERTY()         UStemContainerWave* __container_waves[PTRN_COUNT]; // when the score has a container
         UPROPERTY()         UAudioComponent* __bridge_audio_component; 
         UPROPERTY()         UAudioComponent* __stinger_audio_component;  
         UPROPERTY()         TArray<UAudioComponent*> __all_audio_components;
@@ -174,8 +349,44 @@ GO@MMBMOMMMM@MOGGZMO8GGEZGMMBB@B@@@BO2MOO8@B@B@@@B@B@@@B@B@B@@@Br 7B::;7rriB@B@B
         UPROPERTY()         float __patterns_volume[PTRN_COUNT];
         UPROPERTY()         float __master_volume;
         UPROPERTY()         uint8 __patterns_validation[PTRN_COUNT];
+        UPROPERTY()         float __applied_gains[PTRN_COUNT]; // what audio has been told (master included)
+        UPROPERTY()         uint8 __processed_texture;
+        UPROPERTY()         uint8 __pattern_priorities[PTRN_COUNT];
+        UPROPERTY()         uint8 __budget_dropped; // stems muted by FStemVoiceBudget
+        UPROPERTY()         bool __cues_evicted;    // by FStemCache, reloaded on Run
+        UPROPERTY()         bool __gains_settled;   // __applied_gains are exactly the gains of __processed_texture
+                            FTransitionPlanCache __transition_plans;
+        
+        UPROPERTY()         bool __fade_engine_enabled;
+        UPROPERTY()         uint8 __fade_engine_stems; // stems whose sound carries UStemGainSourcePreset
+                            void __routeFadeEngine();
+                            bool __isOnFadeEngine(uint8 index) const;
+                            static bool __hasStemGainSource(USoundBase* sound);
+                            void __unregisterFadeEngine(); // components may be gone by the destructor.
+                            TSharedPtr<FStemFadeEngine, ESPMode::ThreadSafe> __fade_engine;
+                            TSharedPtr<FStemDuckingListener, ESPMode::ThreadSafe> __ducking_listener; // kept until destruction,
+        UPROPERTY()         USoundSubmix* __ducking_submix;                                           // the audio thread may still hold it.
+        UPROPERTY()         bool __ducking_active;
+        
+        UPROPERTY()         bool __intensity_mode;
+        UPROPERTY()         float __intensity_smoothing_time;
         
         UPROPERTY()         FTimerHandle __bridge_timer_handle;
+        UPROPERTY()         bool __bridge_pending;
+        UPROPERTY()         int __bridge_index;
+        UPROPERTY()         float __bridge_volume;
+        UPROPERTY()         float __bridge_start_time;
+        UPROPERTY()         float __bridge_crossfade_time;
+        
+        UPROPERTY()         float __transport_start_time; // world audio time of pattern position 0
+        UPROPERTY()         float __pattern_length;
+        UPROPERTY()         FTimerHandle __texture_rules_timer_handle;
+        UPROPERTY()         FTimerHandle __arbitration_timer_handle;
+        
+        UPROPERTY()         TArray<UScoreLayer*> __layers;
+        UPROPERTY()         float __bar_length;
+        UPROPERTY()         FTimerHandle __layer_bar_timer_handle;
+        UPROPERTY()         FTimerHandle __layer_realign_timer_handle;
     
         UPROPERTY()         UAdaptiveScore* __loaded_score; 
         UPROPERTY()         float __score_fade_time;
@@ -186,21 +397,112 @@ GO@MMBMOMMMM@MOGGZMO8GGEZGMMBB@B@@@BO2MOO8@B@B@@@B@B@@@B@B@B@@@Br 7B::;7rriB@B@B
     
     private:
         
-        UFUNCTION()         void __beginToPlaySilently();       
+        UFUNCTION()         void __beginToPlaySilently(float start_time = 0.0f);       
         UFUNCTION()         void __muteTrack(uint8 index, float fade);  
         UFUNCTION()         void __decodeFromByte(uint8 processed_texture, float fade);     
         UFUNCTION()         void __adjustPatternVolume(uint8 index, float volume, float fade);      
         UFUNCTION()         uint8 __getFilteredTexture();
+                            uint8 __filterTexture(uint8 texture) const;
+                            bool __playTransitionPlan(uint8 from_texture, uint8 to_texture);
+                            FTransitionPlan __buildTransitionPlan(uint8 from_texture, uint8 to_texture) const;
+                            void __computePatternGains(uint8 processed_texture, float gains[]);
+                            void __pushPatternGains(const float gains[], float fade);
+                            void __applyVoiceBudget(float gains[], float fade, bool request);
         
         UFUNCTION()         void __onBridgeCrossfadeTimer(float fade); 
+        UFUNCTION()         void __onTextureRulesTimer();
+        UFUNCTION()         void __onArbitrationTimer();
+        
+        UFUNCTION()         void __optimizeFilterChains();
+        
+        UFUNCTION()         UScoreLayer* __getLayer(int layer);
+        UFUNCTION()         void __queueLayerChange(UScoreLayer* layer, bool active, uint8 texture, bool on_bar);
+        UFUNCTION()         void __applyLayerChange(UScoreLayer* layer);
+        UFUNCTION()         void __decodeLayers(float fade);
+        UFUNCTION()         void __onLayerBarTimer();
+        UFUNCTION()         void __onLayerRealignTimer();
+        
+        UFUNCTION()         void __routeDuckingSends();
+        UFUNCTION()         void __startDucking();
+        UFUNCTION()         void __stopDucking();
         
         UFUNCTION()         float __verifiedVolume(float volume);
         UFUNCTION()         void __initializeDefaultVolume();
         
         UFUNCTION()         bool __isSoundBaseValid(USoundBase* base_ptr);
+        UFUNCTION()         void __acquireCues();
+        
+                            double __getAudioClock();
+                            void __recordControl(EMixerControlOp op, const TArray<float>& args,
+                                const FString& object_path = FString());
+                            FMixerControlLog __control_log;
+                            bool __control_nested; // calls made from inside a recorded call are not logged.
+        
+        UPROPERTY(ReplicatedUsing = __onRepTexture)     uint8 __rep_texture;
+        UPROPERTY(ReplicatedUsing = __onRepTransport)   FMixerReplicatedTransport __rep_transport;
+        UPROPERTY(ReplicatedUsing = __onRepServerClock) float __rep_server_audio_time;
+                            float __server_clock_offset;    // client: server audio time - local audio time
+                            bool __server_clock_valid;
+                            bool __applying_replication;
+        
+        UFUNCTION()         void __onRepTexture();
+        UFUNCTION()         void __onRepTransport();
+        UFUNCTION()         void __onRepServerClock();
+        UFUNCTION(NetMulticast, Reliable)   void __multicastBridge(uint8 new_texture, FMixerPackedIndex bridge_index,
+                                            uint8 fade_out_ratio, uint8 fade_in_ratio, uint8 bridge_volume);
+        UFUNCTION(NetMulticast, Reliable)   void __multicastStinger(FMixerPackedIndex index, uint8 stinger_volume);
+                            bool __isReplicationServer() const;
+                            bool __ignoresLocalControl() const; // a client replica only follows the server.
+                            void __seekToServerTransport();
+        
+        UPROPERTY()         bool __prepared;    // stems started paused by Prepare, Run unpauses them
+                            double __start_requested_time;  // FPlatformTime, 0 = nothing to measure
+                            float __start_probe_percent;    // last reported before Run, -1 = none
+                            double __bridge_requested_time;
+                            float __start_latency;          // ms, -1 = not measured yet
+                            float __bridge_start_latency;
+                            void __discardPreroll();
+                            void __armStartProbe();
+                            void __onStemPlaybackPercent(const UAudioComponent* component, const USoundWave* wave, const float percent);
+                            void __onBridgePlaybackPercent(const UAudioComponent* component, const USoundWave* wave, const float percent);
+                            void __onStingerPlaybackPercent(const UAudioComponent* component, const USoundWave* wave, const float percent);
+        
+                            uint32 __latency_token;         // FControlLatencyTracker, of the call in progress
+                            bool __latency_on_render;       // the fade engine carries the token
+                            bool __latency_on_audio_thread; // a component gain change went to the audio thread
+                            uint32 __run_latency_token;     // waiting for the first playback report
+                            uint32 __bridge_latency_token;  // of the sound the call started
+                            uint32 __stinger_latency_token;
+                            void __beginLatency(EControlLatencyEvent type);
+                            void __endLatency(uint32* started_sound_token = nullptr);
+                            void __completeStartLatency(uint32& started_sound_token);
+        
+                            FListenerGainSet __listener_sets[MAX_LISTENER_SETS]; // [0] unused, that's the mixer itself
+                            int __listener_set_count;
+                            FListenerGainSet* __getListenerSet(int listener);
+                            void __decodeListenerChange();
+        
+                            TArray<FMixerPendingTransition> __pending_transitions; // the mixer ticks only while there are some.
+                            uint32 __run_serial;      // counts transitions that started,
+                            uint32 __bridge_serial;   // a newer one cuts the pending one off.
+                            uint32 __stinger_serial;
+                            uint32 __transitionSerial(EMixerTransition kind) const;
+                            void __awaitTransition(EMixerTransition kind, uint32 serial_before, float land_time,
+                                TFunction<void(bool)> on_landed);
+                            void __completeTransitions();
+                            void __cancelTransitions();
                 
     public:
     
+        void OnVoiceBudgetChanged(); // called by FStemVoiceBudget when another mixer freed or took stems.
+        void OnScoreCuesEvicted();   // called by FStemCache before the loaded score drops its cues.
+        
+        virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+        virtual void BeginDestroy() override;
+        virtual void Tick(float DeltaSeconds) override;
+        virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+        virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+    
         AAdaptiveMixer();
         ~AAdaptiveMixer();
     
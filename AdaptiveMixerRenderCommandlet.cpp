@@ -0,0 +1,269 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "AdaptiveMixerRenderCommandlet.h"
+#include "AdaptiveMixer.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/FileHelper.h"
+#include "HAL/PlatformTime.h"
+#include "Audio.h"
+#include "AudioDevice.h"
+#include "AudioThread.h"
+#include "AudioMixerDevice.h"
+#include "AudioMixerPlatformNonRealtime.h"
+
+constexpr float RENDER_TAIL_TIME = 10.0f; // rendered after the last event if the script has no "end".
+
+struct FRenderEvent
+{
+    float time;
+    FString command;
+    TArray<FString> args;
+};
+
+struct FRenderScript
+{
+    TArray<USoundCue*> patterns;
+    TArray<USoundCue*> bridges;
+    TArray<USoundCue*> stingers;
+    float fade_time = 1.0f;
+    uint8 filterchain_index = 0;
+    TArray<TArray<FString>> filters;
+    TArray<FRenderEvent> events;
+    float end_time = -1.0f;
+};
+
+static bool LoadRenderCue(const FString& path, TArray<USoundCue*>& cues) {
+
+    USoundCue* cue = LoadObject<USoundCue>(nullptr, *path);
+    if (cue == nullptr) {
+        UE_LOG(AdaptiveMixerLog, Error, TEXT("Can't load sound cue %s."), *path);
+        return false;
+    }
+    cues.Add(cue);
+    return true;
+}
+
+static bool ParseRenderScript(const FString& script_path, FRenderScript& script) {
+
+    TArray<FString> lines;
+    if (!FFileHelper::LoadFileToStringArray(lines, *script_path)) {
+        UE_LOG(AdaptiveMixerLog, Error, TEXT("Can't read render script %s."), *script_path);
+        return false;
+    }
+
+    for (int l = 0; l < lines.Num(); ++l) {
+        FString line = lines[l].TrimStartAndEnd();
+        if (line.IsEmpty() || line.StartsWith(TEXT("#")))
+            continue;
+
+        TArray<FString> tokens;
+        line.ParseIntoArrayWS(tokens);
+        FString keyword = tokens[0].ToLower();
+        bool ok = true;
+
+        if ((keyword == TEXT("pattern")) && (tokens.Num() == 2))
+            ok = LoadRenderCue(tokens[1], script.patterns);
+        else if ((keyword == TEXT("bridge")) && (tokens.Num() == 2))
+            ok = LoadRenderCue(tokens[1], script.bridges);
+        else if ((keyword == TEXT("stinger")) && (tokens.Num() == 2))
+            ok = LoadRenderCue(tokens[1], script.stingers);
+        else if ((keyword == TEXT("fade")) && (tokens.Num() == 2))
+            script.fade_time = FCString::Atof(*tokens[1]);
+        else if ((keyword == TEXT("filterchain")) && (tokens.Num() == 2))
+            script.filterchain_index = FCString::Atoi(*tokens[1]);
+        else if ((keyword == TEXT("filter")) && (tokens.Num() == 5))
+            script.filters.Add(TArray<FString>(&tokens[1], 4));
+        else if ((keyword == TEXT("at")) && (tokens.Num() >= 3)) {
+            FRenderEvent e;
+            e.time = FCString::Atof(*tokens[1]);
+            e.command = tokens[2].ToLower();
+            for (int i = 3; i < tokens.Num(); ++i) {
+                e.args.Add(tokens[i]);
+            }
+            if (e.command == TEXT("end"))
+                script.end_time = e.time;
+            else
+                script.events.Add(e);
+        }
+        else {
+            UE_LOG(AdaptiveMixerLog, Error, TEXT("Render script line %d is not understood: %s"), l + 1, *line);
+            ok = false;
+        }
+
+        if (!ok)
+            return false;
+    }
+
+    script.events.StableSort([](const FRenderEvent& a, const FRenderEvent& b) { return a.time < b.time; });
+    if (script.end_time < 0.0f)
+        script.end_time = (script.events.Num() > 0 ? script.events.Last().time : 0.0f) + RENDER_TAIL_TIME;
+    return true;
+}
+
+static float RenderArg(const FRenderEvent& e, int index, float default_value) {
+    return index < e.args.Num() ? FCString::Atof(*e.args[index]) : default_value;
+}
+
+static void ApplyRenderEvent(AAdaptiveMixer* mixer, const FRenderEvent& e) {
+
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("[%8.3f] %s"), e.time, *e.command);
+
+    if (e.command == TEXT("run"))
+        mixer->Run(uint8(RenderArg(e, 0, 1.0f)));
+    else if (e.command == TEXT("stop"))
+        mixer->Stop();
+    else if (e.command == TEXT("texture"))
+        mixer->PlayNewTexture(uint8(RenderArg(e, 0, 0.0f)));
+    else if (e.command == TEXT("bridge"))
+        mixer->PlayNewTextureAfterBridge(uint8(RenderArg(e, 0, 0.0f)), int(RenderArg(e, 1, 0.0f)),
+            RenderArg(e, 2, 0.5f), RenderArg(e, 3, 0.5f), RenderArg(e, 4, 1.0f));
+    else if (e.command == TEXT("stinger"))
+        mixer->PlayStinger(int(RenderArg(e, 0, 0.0f)), RenderArg(e, 1, 1.0f));
+    else if (e.command == TEXT("master"))
+        mixer->SetMasterVolume(RenderArg(e, 0, 1.0f));
+    else if (e.command == TEXT("volume"))
+        mixer->SetPatternVolume(uint8(RenderArg(e, 0, 0.0f)), RenderArg(e, 1, 1.0f));
+    else
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Unknown render event %s, skipped."), *e.command);
+}
+
+static bool SaveRenderedWave(const FString& out_path, const Audio::AlignedFloatBuffer& buffer,
+    int32 channels, int32 sample_rate) {
+
+    TArray<int16> pcm;
+    pcm.SetNumUninitialized(buffer.Num());
+    for (int i = 0; i < buffer.Num(); ++i) {
+        pcm[i] = int16(FMath::Clamp(buffer[i] * 32767.0f, -32768.0f, 32767.0f));
+    }
+
+    TArray<uint8> wave;
+    SerializeWaveFile(wave, reinterpret_cast<const uint8*>(pcm.GetData()), pcm.Num() * sizeof(int16),
+        channels, sample_rate);
+    return FFileHelper::SaveArrayToFile(wave, *out_path);
+}
+
+int32 UAdaptiveMixerRenderCommandlet::Main(const FString& Params) {
+
+    FString script_path;
+    FString out_path;
+    float tick = 1.0f / 60.0f;
+
+    if (!FParse::Value(*Params, TEXT("Script="), script_path) || !FParse::Value(*Params, TEXT("Out="), out_path)) {
+        UE_LOG(AdaptiveMixerLog, Error, TEXT("Usage: -run=AdaptiveMixerRender -Script=<file> -Out=<file.wav>"));
+        return 1;
+    }
+    FParse::Value(*Params, TEXT("Tick="), tick);
+    if (tick <= 0.0f) {
+        UE_LOG(AdaptiveMixerLog, Error, TEXT("-Tick must be positive."));
+        return 1;
+    }
+
+    FRenderScript script;
+    if (!ParseRenderScript(script_path, script))
+        return 1;
+
+    FString replay_path;
+    FMixerControlLog replay;
+    if (FParse::Value(*Params, TEXT("Replay="), replay_path)) {
+        if (!replay.Load(replay_path)) {
+            UE_LOG(AdaptiveMixerLog, Error, TEXT("Can't load control log %s."), *replay_path);
+            return 1;
+        }
+        const TArray<FMixerControlEvent>& logged = replay.GetEvents();
+        float replay_end = (logged.Num() > 0 ? logged.Last().audio_time : 0.0f) + RENDER_TAIL_TIME;
+        script.end_time = FMath::Max(script.end_time, replay_end);
+        UE_LOG(AdaptiveMixerLog, Display, TEXT("Replaying %d control events."), logged.Num());
+    }
+
+    // headless world:
+    UWorld* world = UWorld::CreateWorld(EWorldType::Game, true, FName("AdaptiveMixerRender"));
+    FWorldContext& context = GEngine->CreateNewWorldContext(EWorldType::Game);
+    context.SetCurrentWorld(world);
+    world->InitializeActorsForPlay(FURL());
+    world->BeginPlay();
+
+    FAudioDevice* device = world->GetAudioDevice();
+    if ((device == nullptr) || !device->IsNonRealtime()) {
+        UE_LOG(AdaptiveMixerLog, Error, TEXT("No non-realtime audio device. Run with -AudioMixer -deterministicaudio -AllowCommandletAudio."));
+        GEngine->DestroyWorldContext(world);
+        world->DestroyWorld(false);
+        return 1;
+    }
+    Audio::FMixerDevice* mixer_device = static_cast<Audio::FMixerDevice*>(device);
+    Audio::FMixerPlatformNonRealtime* platform =
+        static_cast<Audio::FMixerPlatformNonRealtime*>(mixer_device->GetAudioMixerPlatform());
+
+    // mixer, exactly like a game would set it up:
+    AAdaptiveMixer* mixer = world->SpawnActor<AAdaptiveMixer>();
+    UAdaptiveScore* score = mixer->GetDefaultAdaptiveScore();
+    score->InitializeScoreFull(script.patterns, script.bridges, script.stingers,
+        script.fade_time, script.filterchain_index);
+    if (!mixer->InitializeMixer(score)) {
+        GEngine->DestroyWorldContext(world);
+        world->DestroyWorld(false);
+        return 1;
+    }
+    for (const TArray<FString>& f : script.filters) {
+        mixer->GetDynamicFilterChain()->AddFilter(uint8(FCString::Atoi(*f[0])), f[1],
+            uint8(FCString::Atoi(*f[2])), f[3].ToBool());
+    }
+
+    // render:
+    mixer_device->StartRecording(nullptr, script.end_time);
+    double wall_start = FPlatformTime::Seconds();
+    double audio_clock_start = device->GetAudioClock();
+    float time = 0.0f;
+    int next_event = 0;
+    int next_replayed = 0;
+    const TArray<FMixerControlEvent>& replayed = replay.GetEvents();
+    while (time < script.end_time) {
+        while ((next_event < script.events.Num()) && (script.events[next_event].time <= time)) {
+            ApplyRenderEvent(mixer, script.events[next_event]);
+            ++next_event;
+        }
+        // logged calls follow the audio clock they were recorded against, whatever the -Tick:
+        float audio_time = float(device->GetAudioClock() - audio_clock_start);
+        while ((next_replayed < replayed.Num()) && (replayed[next_replayed].audio_time <= audio_time)) {
+            mixer->ReplayControlEvent(replayed[next_replayed]);
+            ++next_replayed;
+        }
+        world->Tick(LEVELTICK_All, tick);
+        GEngine->GetAudioDeviceManager()->UpdateActiveAudioDevices(true);
+
+        FAudioCommandFence fence;
+        fence.BeginFence();
+        fence.Wait();
+        platform->RenderAudio(tick);
+        time += tick;
+    }
+    double wall_time = FPlatformTime::Seconds() - wall_start;
+
+    float channels = 0.0f;
+    float sample_rate = 0.0f;
+    Audio::AlignedFloatBuffer& rendered = mixer_device->StopRecording(nullptr, channels, sample_rate);
+    bool saved = SaveRenderedWave(out_path, rendered, int32(channels), int32(sample_rate));
+
+    mixer->Stop();
+    GEngine->DestroyWorldContext(world);
+    world->DestroyWorld(false);
+
+    if (!saved) {
+        UE_LOG(AdaptiveMixerLog, Error, TEXT("Can't write %s."), *out_path);
+        return 1;
+    }
+
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("Rendered %.2f s to %s in %.2f s (%.1fx realtime)."),
+        script.end_time, *out_path, wall_time, wall_time > 0.0 ? script.end_time / wall_time : 0.0);
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("Mixer + audio CPU cost: %.3f ms per rendered second."),
+        1000.0 * wall_time / script.end_time);
+    return 0;
+}
+
+UAdaptiveMixerRenderCommandlet::UAdaptiveMixerRenderCommandlet() {
+    IsClient = false;
+    IsEditor = false;
+    IsServer = false;
+    LogToConsole = true;
+}
@@ -0,0 +1,51 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "AdaptiveMixerRenderCommandlet.generated.h"
+
+// Renders an adaptive mix to a WAV file faster than realtime.
+//
+// UE4Editor-Cmd <Project> -run=AdaptiveMixerRender -Script=<file.txt> -Out=<file.wav>
+//     [-Tick=0.0166] [-Replay=<file.amcl>] -AudioMixer -deterministicaudio -AllowCommandletAudio -unattended
+//
+// -deterministicaudio selects the non-realtime audio platform, so audio is rendered
+// as fast as the CPU allows instead of following the wall clock. Commandlets get no
+// audio device at all without -AllowCommandletAudio.
+//
+// Script format (one command per line, # = comment):
+//
+//     pattern     /Game/Music/Drums.Drums         // pattern cues, in order
+//     bridge      /Game/Music/Bridge0.Bridge0
+//     stinger     /Game/Music/Hit.Hit
+//     fade        2.0                             // score fade time
+//     filterchain 66                              // static filter chain index
+//     filter      2 and 21 false                  // dynamic filter (track op mask terminate)
+//
+//     at 0.0  run 3
+//     at 4.0  texture 7
+//     at 8.0  bridge 15 0 0.3 0.3 1.0             // texture index out_ratio in_ratio volume
+//     at 9.5  stinger 0 1.0                       // index volume
+//     at 12.0 master 0.5
+//     at 16.0 end
+//
+// -Replay= re-drives the mixer from a control log recorded with
+// AAdaptiveMixer::StartControlRecording. Logged calls are applied at their recorded
+// audio time, on the first frame that reaches it, together with any "at" events of
+// the script. A smaller -Tick places them closer to where they were recorded.
+
+UCLASS()
+class UAdaptiveMixerRenderCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+    public:
+
+    virtual int32 Main(const FString& Params) override;
+
+    UAdaptiveMixerRenderCommandlet();
+
+};
@@ -0,0 +1,10 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+// "stat AdaptiveMixer" in the console.
+DECLARE_STATS_GROUP(TEXT("AdaptiveMixer"), STATGROUP_AdaptiveMixer, STATCAT_Advanced);
@@ -2,6 +2,7 @@
 // © Daniel Winterreise, 2019
 
 #include "AdaptiveScore.h"
+#include "Sound/SoundNodeWavePlayer.h"
 
 
 void UAdaptiveScore::InitializeScoreFull(TArray<USoundCue*> pattern_cues, TArray<USoundCue*> bridge_cues,
@@ -15,6 +16,7 @@ void UAdaptiveScore::InitializeScoreFull(TArray<USoundCue*> pattern_cues, TArray
 
     __fade_time = fade_time;
     __filterchain_index = filterchain_index;
+    __capturePaths();
 }
 
 void UAdaptiveScore::InitializeScorePatternsOnly(TArray<USoundCue*> pattern_cues,
@@ -26,6 +28,7 @@ void UAdaptiveScore::InitializeScorePatternsOnly(TArray<USoundCue*> pattern_cues
     
     __fade_time = fade_time;
     __filterchain_index = filterchain_index;
+    __capturePaths();
 }
 
 void UAdaptiveScore::InitializeScorePatternsAndBridges(TArray<USoundCue*> pattern_cues, TArray<USoundCue*> bridge_cues,
@@ -38,6 +41,7 @@ void UAdaptiveScore::InitializeScorePatternsAndBridges(TArray<USoundCue*> patter
     
     __fade_time = fade_time;
     __filterchain_index = filterchain_index;
+    __capturePaths();
 }
 
 void UAdaptiveScore::InitializeScorePatternsAndStingers(TArray<USoundCue*> pattern_cues, TArray<USoundCue*> stinger_cues,
@@ -50,6 +54,7 @@ void UAdaptiveScore::InitializeScorePatternsAndStingers(TArray<USoundCue*> patte
     
     __fade_time = fade_time;
     __filterchain_index = filterchain_index;
+    __capturePaths();
 }
 
 TArray<USoundCue*> UAdaptiveScore::GetPatternCues() {
@@ -65,6 +70,155 @@ TArray<USoundCue*> UAdaptiveScore::GetStingerCues() {
 }
 
 
+void UAdaptiveScore::SetStemContainer(FString file_path) {
+    __stem_container = file_path;
+}
+
+FString UAdaptiveScore::GetStemContainer() {
+    return __stem_container;
+}
+
+void UAdaptiveScore::SetDucking(USoundSubmix* sidechain_submix, float attack, float release, float depth) {
+    
+    __ducking_submix = sidechain_submix;
+    __ducking_attack = attack;
+    __ducking_release = release;
+    __ducking_depth = depth;
+}
+
+USoundSubmix* UAdaptiveScore::GetDuckingSubmix() {
+    return __ducking_submix;
+}
+
+float UAdaptiveScore::GetDuckingAttack() {
+    return __ducking_attack;
+}
+
+float UAdaptiveScore::GetDuckingRelease() {
+    return __ducking_release;
+}
+
+float UAdaptiveScore::GetDuckingDepth() {
+    return __ducking_depth;
+}
+
+void UAdaptiveScore::SetPatternPriority(uint8 index, uint8 priority) {
+    
+    if (__pattern_priorities.Num() <= index)
+        __pattern_priorities.SetNumZeroed(index + 1);
+    __pattern_priorities[index] = priority;
+}
+
+uint8 UAdaptiveScore::GetPatternPriority(uint8 index) {
+    
+    return index < __pattern_priorities.Num() ? __pattern_priorities[index] : 0;
+}
+
+float UAdaptiveScore::GetLoopLength() {
+    
+    // cues of looping waves report an endless duration, so look at the waves:
+    float length = 0.0f;
+    for (USoundCue* cue : __pattern_cues) {
+        if (!IsValid(cue))
+            continue;
+        
+        TArray<USoundNodeWavePlayer*> players;
+        cue->RecursiveFindNode<USoundNodeWavePlayer>(cue->FirstNode, players);
+        for (USoundNodeWavePlayer* player : players) {
+            if (player->GetSoundWave() != nullptr)
+                length = FMath::Max(length, player->GetSoundWave()->Duration);
+        }
+    }
+    return length;
+}
+
+TArray<USoundWave*> UAdaptiveScore::GetResidentWaves() {
+    
+    TSet<USoundWave*> waves;
+    for (const TArray<USoundCue*>* cues : { &__pattern_cues, &__bridge_cues, &__stinger_cues }) {
+        for (USoundCue* cue : *cues) {
+            if (!IsValid(cue))
+                continue;
+            
+            TArray<USoundNodeWavePlayer*> players;
+            cue->RecursiveFindNode<USoundNodeWavePlayer>(cue->FirstNode, players);
+            for (USoundNodeWavePlayer* player : players) {
+                if (player->GetSoundWave() != nullptr)
+                    waves.Add(player->GetSoundWave());
+            }
+        }
+    }
+    
+    return waves.Array();
+}
+
+int64 UAdaptiveScore::GetResidentBytes() {
+    
+    int64 bytes = 0;
+    for (USoundWave* wave : GetResidentWaves()) {
+        bytes += wave->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
+    }
+    return bytes;
+}
+
+bool UAdaptiveScore::CanReleaseCues() {
+    
+    for (const TArray<USoundCue*>* cues : { &__pattern_cues, &__bridge_cues, &__stinger_cues }) {
+        for (USoundCue* cue : *cues) {
+            if ((cue != nullptr) && !cue->IsAsset())
+                return false;
+        }
+    }
+    return __cues_resident;
+}
+
+bool UAdaptiveScore::AreCuesResident() {
+    return __cues_resident;
+}
+
+void UAdaptiveScore::ReleaseCues() {
+    
+    __pattern_cues.Empty();
+    __bridge_cues.Empty();
+    __stinger_cues.Empty();
+    __cues_resident = false;
+}
+
+void UAdaptiveScore::ReacquireCues() {
+    
+    // same order as before, a cue that can't be loaded stays a null slot:
+    __pattern_cues.Empty();
+    for (const FSoftObjectPath& path : __pattern_paths) {
+        __pattern_cues.Add(Cast<USoundCue>(path.TryLoad()));
+    }
+    __bridge_cues.Empty();
+    for (const FSoftObjectPath& path : __bridge_paths) {
+        __bridge_cues.Add(Cast<USoundCue>(path.TryLoad()));
+    }
+    __stinger_cues.Empty();
+    for (const FSoftObjectPath& path : __stinger_paths) {
+        __stinger_cues.Add(Cast<USoundCue>(path.TryLoad()));
+    }
+    __cues_resident = true;
+}
+
+void UAdaptiveScore::__capturePaths() {
+    
+    __pattern_paths.Empty();
+    for (USoundCue* cue : __pattern_cues) {
+        __pattern_paths.Add(FSoftObjectPath(cue));
+    }
+    __bridge_paths.Empty();
+    for (USoundCue* cue : __bridge_cues) {
+        __bridge_paths.Add(FSoftObjectPath(cue));
+    }
+    __stinger_paths.Empty();
+    for (USoundCue* cue : __stinger_cues) {
+        __stinger_paths.Add(FSoftObjectPath(cue));
+    }
+    __cues_resident = true;
+}
+
 float UAdaptiveScore::GetFadeTime() {
 
     return __fade_time;
@@ -80,10 +234,20 @@ void UAdaptiveScore::Clear() {
     __pattern_cues.Empty();
     __bridge_cues.Empty();
     __stinger_cues.Empty();
+    __pattern_priorities.Empty();
+    __pattern_paths.Empty();
+    __bridge_paths.Empty();
+    __stinger_paths.Empty();
+    __cues_resident = true;
 
 }
 
 UAdaptiveScore::UAdaptiveScore() {
+    __ducking_submix = nullptr;
+    __ducking_attack = 0.01f;
+    __ducking_release = 0.3f;
+    __ducking_depth = 0.5f;
+    __cues_resident = true;
     UE_LOG(LogTemp, Display, TEXT("Adaptive score created."));
 }
 
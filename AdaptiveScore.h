@@ -5,6 +5,7 @@
 
 #include "CoreMinimal.h"
 #include "Sound/SoundCue.h"
+#include "Sound/SoundSubmix.h"
 #include "AdaptiveScore.generated.h"
 
 UCLASS(Blueprintable)
@@ -31,6 +32,23 @@ class UAdaptiveScore : public UObject
                                               TArray<USoundCue*> stinger_cues, float fade_time, uint8 filterchain_index);
                                     
     UFUNCTION(BlueprintCallable)        void Clear();
+    
+    UFUNCTION(BlueprintCallable)        void SetDucking(USoundSubmix* sidechain_submix, float attack = 0.01f,
+                                        float release = 0.3f, float depth = 0.5f);
+                                        // Stingers and bridges send to sidechain_submix, its
+                                        // envelope ducks the patterns on the audio thread
+                                        // (depth 1.0 = down to silence). Needs the mixer's
+                                        // fade engine (AAdaptiveMixer::SetFadeEngine).
+                                        
+    UFUNCTION(BlueprintCallable)        void SetPatternPriority(uint8 index, uint8 priority);
+                                        // Higher = kept longer when the stem budget is exceeded
+                                        // (au.AdaptiveMixer.StemBudget). Default 0, ties keep
+                                        // the lower pattern index. Set after InitializeScore..
+
+    UFUNCTION(BlueprintCallable)        void SetStemContainer(FString file_path);
+                                        // Patterns play from this packed stem container
+                                        // (UStemContainerLibrary::PackStemContainer) instead
+                                        // of the pattern cues. Empty = use the cues.
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++    
 //==============================================================================================================
@@ -39,6 +57,25 @@ class UAdaptiveScore : public UObject
     UFUNCTION() TArray<USoundCue*>  GetBridgeCues();
     UFUNCTION() TArray<USoundCue*>  GetStingerCues();
     
+    UFUNCTION() uint8 GetPatternPriority(uint8 index);
+    
+    UFUNCTION() FString GetStemContainer();
+    
+    UFUNCTION() USoundSubmix* GetDuckingSubmix();
+    UFUNCTION() float GetDuckingAttack();
+    UFUNCTION() float GetDuckingRelease();
+    UFUNCTION() float GetDuckingDepth();
+    
+    UFUNCTION() float GetLoopLength(); // longest pattern wave, in seconds.
+    
+    // used by FStemCache:
+    UFUNCTION() TArray<USoundWave*> GetResidentWaves(); // all waves of all cues, each once.
+    UFUNCTION() int64 GetResidentBytes();
+    UFUNCTION() bool CanReleaseCues();      // every cue is an asset that can be loaded again.
+    UFUNCTION() bool AreCuesResident();
+    UFUNCTION() void ReleaseCues();         // drops the cues, keeps their asset paths.
+    UFUNCTION() void ReacquireCues();
+    
     UFUNCTION() float GetFadeTime();    
     UFUNCTION() uint8 GetFilterchainIndex();
         
@@ -48,6 +85,32 @@ class UAdaptiveScore : public UObject
         TArray<USoundCue*> __bridge_cues;
         TArray<USoundCue*> __stinger_cues;
         
+        UPROPERTY()
+        TArray<FSoftObjectPath> __pattern_paths;
+        UPROPERTY()
+        TArray<FSoftObjectPath> __bridge_paths;
+        UPROPERTY()
+        TArray<FSoftObjectPath> __stinger_paths;
+        UPROPERTY()
+        bool __cues_resident;
+        
+        UFUNCTION() void __capturePaths();
+        
+        UPROPERTY()
+        TArray<uint8> __pattern_priorities;
+        
+        UPROPERTY()
+        FString __stem_container;
+        
+        UPROPERTY()
+        USoundSubmix* __ducking_submix;
+        UPROPERTY()
+        float __ducking_attack;
+        UPROPERTY()
+        float __ducking_release;
+        UPROPERTY()
+        float __ducking_depth;
+        
         UPROPERTY()
         float __fade_time;
         UPROPERTY()
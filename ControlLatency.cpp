@@ -0,0 +1,239 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "ControlLatency.h"
+#include "AdaptiveMixer.h"
+#include "AdaptiveMixerStats.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+#include "Containers/Queue.h"
+#include "Containers/Ticker.h"
+#include "AudioDevice.h"
+#include "AudioThread.h"
+
+static TAutoConsoleVariable<int32> CVarTrackControlLatency(
+    TEXT("au.AdaptiveMixer.TrackControlLatency"),
+    0,
+    TEXT("1 = measure the time from mixer control calls to the audio they change (see au.AdaptiveMixer.DumpControlLatency)."),
+    ECVF_Default);
+
+static FAutoConsoleCommand DumpControlLatencyCommand(
+    TEXT("au.AdaptiveMixer.DumpControlLatency"),
+    TEXT("Logs p50 / p95 / p99 control-to-audio latency per event type."),
+    FConsoleCommandDelegate::CreateLambda([]() { FControlLatencyTracker::Get().Dump(); }));
+
+static FAutoConsoleCommand ResetControlLatencyCommand(
+    TEXT("au.AdaptiveMixer.ResetControlLatency"),
+    TEXT("Clears the control latency histograms."),
+    FConsoleCommandDelegate::CreateLambda([]() { FControlLatencyTracker::Get().Reset(); }));
+
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Run latency p50 (ms)"), STAT_AdaptiveMixerRunP50, STATGROUP_AdaptiveMixer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Run latency p95 (ms)"), STAT_AdaptiveMixerRunP95, STATGROUP_AdaptiveMixer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Run latency p99 (ms)"), STAT_AdaptiveMixerRunP99, STATGROUP_AdaptiveMixer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Texture latency p50 (ms)"), STAT_AdaptiveMixerTextureP50, STATGROUP_AdaptiveMixer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Texture latency p95 (ms)"), STAT_AdaptiveMixerTextureP95, STATGROUP_AdaptiveMixer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Texture latency p99 (ms)"), STAT_AdaptiveMixerTextureP99, STATGROUP_AdaptiveMixer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Bridge latency p50 (ms)"), STAT_AdaptiveMixerBridgeP50, STATGROUP_AdaptiveMixer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Bridge latency p95 (ms)"), STAT_AdaptiveMixerBridgeP95, STATGROUP_AdaptiveMixer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Bridge latency p99 (ms)"), STAT_AdaptiveMixerBridgeP99, STATGROUP_AdaptiveMixer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Stinger latency p50 (ms)"), STAT_AdaptiveMixerStingerP50, STATGROUP_AdaptiveMixer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Stinger latency p95 (ms)"), STAT_AdaptiveMixerStingerP95, STATGROUP_AdaptiveMixer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Stinger latency p99 (ms)"), STAT_AdaptiveMixerStingerP99, STATGROUP_AdaptiveMixer);
+
+constexpr double PENDING_TIMEOUT = 5.0; // seconds; e.g. a sound that never reports its playback.
+
+// Completes tokens on the render thread. A token handed over while buffer n renders
+// may have missed its source updates, which the renderer picks up before a buffer,
+// so it waits for buffer n + 1 to be done.
+
+class FControlLatencyRenderProbe : public ISubmixBufferListener
+{
+    public:
+
+    void Push(uint32 token) {    // audio thread
+        __tokens.Enqueue({ token, __rendered.GetValue() + 2 });
+    }
+
+    virtual void OnNewSubmixBuffer(const USoundSubmix* OwningSubmix, float* AudioData, int32 NumSamples,
+        int32 NumChannels, const int32 SampleRate, double AudioClock) override {
+
+        int32 rendered = __rendered.Increment();
+        TPair<uint32, int32> pending;
+        while (__tokens.Peek(pending) && (pending.Value <= rendered)) {
+            FControlLatencyTracker::Get().Complete(pending.Key);
+            __tokens.Pop();
+        }
+    }
+
+    private:
+
+    TQueue<TPair<uint32, int32>, EQueueMode::Spsc> __tokens; // token, buffer count that completes it
+    FThreadSafeCounter __rendered;
+};
+
+static const TCHAR* ControlEventName(int type) {
+
+    static const TCHAR* names[] = { TEXT("Run"), TEXT("Texture"), TEXT("Bridge"), TEXT("Stinger") };
+    return names[type];
+}
+
+FControlLatencyTracker& FControlLatencyTracker::Get() {
+    static FControlLatencyTracker tracker;
+    return tracker;
+}
+
+FControlLatencyTracker::FControlLatencyTracker() {
+
+    // completions land on any thread, the stats follow them every frame:
+    FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([this](float) {
+        __publishStats();
+        return true;
+    }));
+}
+
+bool FControlLatencyTracker::IsEnabled() {
+    return CVarTrackControlLatency.GetValueOnGameThread() != 0;
+}
+
+uint32 FControlLatencyTracker::Begin(EControlLatencyEvent type) {
+
+    if (!IsEnabled())
+        return 0;
+
+    double now = FPlatformTime::Seconds();
+    FScopeLock lock(&__lock);
+    for (TMap<uint32, FPendingControl>::TIterator it = __pending.CreateIterator(); it; ++it) {
+        if (now - it.Value().issued > PENDING_TIMEOUT)
+            it.RemoveCurrent();
+    }
+
+    uint32 token = __next_token++;
+    if (__next_token == 0)
+        __next_token = 1;
+    __pending.Add(token, { type, now });
+    return token;
+}
+
+void FControlLatencyTracker::Cancel(uint32 token) {
+
+    if (token == 0)
+        return;
+
+    FScopeLock lock(&__lock);
+    __pending.Remove(token);
+}
+
+void FControlLatencyTracker::Complete(uint32 token) {
+
+    if (token == 0)
+        return;
+
+    double now = FPlatformTime::Seconds();
+    FScopeLock lock(&__lock);
+    FPendingControl pending;
+    if (!__pending.RemoveAndCopyValue(token, pending))
+        return;
+
+    int type = int(pending.type);
+    if (__histograms[type].Num() == 0)
+        __histograms[type].SetNumZeroed(LATENCY_BUCKET_COUNT);
+    int bucket = FMath::Min(int((now - pending.issued) * 1000.0 / LATENCY_BUCKET_MS), LATENCY_BUCKET_COUNT - 1);
+    ++__histograms[type][bucket];
+    ++__counts[type];
+    __stats_dirty = true;
+}
+
+void FControlLatencyTracker::CompleteOnRender(FAudioDevice* device, uint32 token) {
+
+    if (token == 0)
+        return;
+    if (device == nullptr) {
+        Cancel(token);
+        return;
+    }
+
+    TSharedPtr<FControlLatencyRenderProbe, ESPMode::ThreadSafe>& probe = __probes.FindOrAdd(device->DeviceHandle);
+    if (!probe.IsValid()) {
+        probe = MakeShared<FControlLatencyRenderProbe, ESPMode::ThreadSafe>();
+        device->RegisterSubmixBufferListener(probe.Get()); // the master submix renders every buffer.
+    }
+
+    // queued behind the component commands of the call:
+    TSharedPtr<FControlLatencyRenderProbe, ESPMode::ThreadSafe> pushed = probe;
+    FAudioThread::RunCommandOnAudioThread([pushed, token]() { pushed->Push(token); });
+}
+
+float FControlLatencyTracker::GetPercentile(EControlLatencyEvent type, float percentile) const {
+
+    FScopeLock lock(&__lock);
+    return __percentile(int(type), percentile);
+}
+
+uint32 FControlLatencyTracker::GetSampleCount(EControlLatencyEvent type) const {
+
+    FScopeLock lock(&__lock);
+    return __counts[int(type)];
+}
+
+float FControlLatencyTracker::__percentile(int type, float percentile) const {
+
+    if (__counts[type] == 0)
+        return -1.0f;
+
+    // upper edge of the bucket holding the sample:
+    uint32 rank = uint32(FMath::CeilToInt(FMath::Clamp(percentile, 0.0f, 1.0f) * __counts[type]));
+    uint32 seen = 0;
+    for (int b = 0; b < LATENCY_BUCKET_COUNT; ++b) {
+        seen += __histograms[type][b];
+        if (seen >= FMath::Max(rank, 1u))
+            return (b + 1) * LATENCY_BUCKET_MS;
+    }
+    return LATENCY_BUCKET_COUNT * LATENCY_BUCKET_MS;
+}
+
+void FControlLatencyTracker::__publishStats() {
+
+    FScopeLock lock(&__lock);
+    if (!__stats_dirty)
+        return;
+    __stats_dirty = false;
+
+    SET_FLOAT_STAT(STAT_AdaptiveMixerRunP50, __percentile(int(EControlLatencyEvent::Run), 0.50f));
+    SET_FLOAT_STAT(STAT_AdaptiveMixerRunP95, __percentile(int(EControlLatencyEvent::Run), 0.95f));
+    SET_FLOAT_STAT(STAT_AdaptiveMixerRunP99, __percentile(int(EControlLatencyEvent::Run), 0.99f));
+    SET_FLOAT_STAT(STAT_AdaptiveMixerTextureP50, __percentile(int(EControlLatencyEvent::Texture), 0.50f));
+    SET_FLOAT_STAT(STAT_AdaptiveMixerTextureP95, __percentile(int(EControlLatencyEvent::Texture), 0.95f));
+    SET_FLOAT_STAT(STAT_AdaptiveMixerTextureP99, __percentile(int(EControlLatencyEvent::Texture), 0.99f));
+    SET_FLOAT_STAT(STAT_AdaptiveMixerBridgeP50, __percentile(int(EControlLatencyEvent::Bridge), 0.50f));
+    SET_FLOAT_STAT(STAT_AdaptiveMixerBridgeP95, __percentile(int(EControlLatencyEvent::Bridge), 0.95f));
+    SET_FLOAT_STAT(STAT_AdaptiveMixerBridgeP99, __percentile(int(EControlLatencyEvent::Bridge), 0.99f));
+    SET_FLOAT_STAT(STAT_AdaptiveMixerStingerP50, __percentile(int(EControlLatencyEvent::Stinger), 0.50f));
+    SET_FLOAT_STAT(STAT_AdaptiveMixerStingerP95, __percentile(int(EControlLatencyEvent::Stinger), 0.95f));
+    SET_FLOAT_STAT(STAT_AdaptiveMixerStingerP99, __percentile(int(EControlLatencyEvent::Stinger), 0.99f));
+}
+
+void FControlLatencyTracker::Dump() const {
+
+    FScopeLock lock(&__lock);
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("---- Control latency (ms, %.2f ms buckets) ----"), LATENCY_BUCKET_MS);
+    for (int t = 0; t < int(EControlLatencyEvent::Count); ++t) {
+        if (__counts[t] == 0) {
+            UE_LOG(AdaptiveMixerLog, Display, TEXT("%-8s no samples"), ControlEventName(t));
+            continue;
+        }
+        UE_LOG(AdaptiveMixerLog, Display, TEXT("%-8s %6u samples   p50 %7.2f   p95 %7.2f   p99 %7.2f"),
+            ControlEventName(t), __counts[t], __percentile(t, 0.50f), __percentile(t, 0.95f), __percentile(t, 0.99f));
+    }
+    if (__pending.Num() > 0)
+        UE_LOG(AdaptiveMixerLog, Display, TEXT("%d calls still on their way to audio."), __pending.Num());
+}
+
+void FControlLatencyTracker::Reset() {
+
+    FScopeLock lock(&__lock);
+    for (int t = 0; t < int(EControlLatencyEvent::Count); ++t) {
+        __histograms[t].Empty();
+        __counts[t] = 0;
+    }
+    __stats_dirty = true;
+}
@@ -0,0 +1,81 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FAudioDevice;
+class FControlLatencyRenderProbe;
+
+// Time from a control call on the game thread to the audio it changes.
+// On with au.AdaptiveMixer.TrackControlLatency 1; "stat AdaptiveMixer" shows the
+// percentiles, au.AdaptiveMixer.DumpControlLatency logs them per event type.
+//
+// The mixer opens a token per call (Begin) and hands it to whatever carries the change:
+//
+//     fade engine      the token rides on FStemFadeCommand and completes in the render
+//                      buffer that starts the fade -- exact
+//     render probe     gain changes without the fade engine: an audio thread command
+//                      queued behind them passes the token to a buffer listener on the
+//                      device, which completes it once the next buffer is rendered -- up
+//                      to one buffer late
+//     playback report  Run, bridges and stingers start sounds, which may take buffers to
+//                      come up: the first playback report of the sound completes the
+//                      token -- late by the hop back to the game thread
+//
+// The first completion of a token counts, later ones are ignored. The stats are
+// published once per frame.
+
+enum class EControlLatencyEvent : uint8
+{
+    Run,
+    Texture,
+    Bridge,
+    Stinger,
+    Count
+};
+
+constexpr float LATENCY_BUCKET_MS = 0.25f;
+constexpr int LATENCY_BUCKET_COUNT = 2000;  // up to 500 ms, the last bucket takes the rest
+
+class FControlLatencyTracker
+{
+    public:
+
+    static FControlLatencyTracker& Get();
+    static bool IsEnabled();
+
+    uint32 Begin(EControlLatencyEvent type);    // game thread, 0 when disabled
+    void Cancel(uint32 token);                  // nothing audible came of the call
+    void Complete(uint32 token);                // any thread
+    void CompleteOnRender(FAudioDevice* device, uint32 token);  // game thread, see "render probe"
+
+    float GetPercentile(EControlLatencyEvent type, float percentile) const; // ms, -1 = no samples
+    uint32 GetSampleCount(EControlLatencyEvent type) const;
+
+    void Dump() const;
+    void Reset();
+
+    FControlLatencyTracker();
+
+    private:
+
+    struct FPendingControl
+    {
+        EControlLatencyEvent type;
+        double issued;  // FPlatformTime::Seconds
+    };
+
+    float __percentile(int type, float percentile) const; // __lock held
+    void __publishStats();
+
+    mutable FCriticalSection __lock;
+    uint32 __next_token = 1;
+    TMap<uint32, FPendingControl> __pending;
+    TArray<uint32> __histograms[int(EControlLatencyEvent::Count)];
+    uint32 __counts[int(EControlLatencyEvent::Count)] = {};
+    bool __stats_dirty = false;
+
+    TMap<uint32, TSharedPtr<FControlLatencyRenderProbe, ESPMode::ThreadSafe>> __probes; // by device handle, game thread
+};
@@ -2,6 +2,7 @@
 // © Daniel Winterreise, 2019
 
 #include "FilterChain.h"
+#include "FilterChainProfiler.h"
 
 constexpr int BYTE_SIZE = 8;
 
@@ -74,6 +75,8 @@ uint8 UStaticFilterChain::ApplyFilterChain(uint8 source_texture, uint8 filtercha
     //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
     //=================================================================================================
 
+    if (FFilterChainProfiler::IsEnabled())
+        FFilterChainProfiler::Get().CountStaticChain(filterchain_index, result != source_texture);
     return result;
 }
 
@@ -83,7 +86,7 @@ uint8 FFilter::Apply(uint8 source_texture, bool & changed) {
     bool tracks[BYTE_SIZE];
     bool c = false;
     UStaticFilterChain::BoolArrayFromByte(source_texture, tracks);
-    if (tracks[__track]) {
+    if ((__track < BYTE_SIZE) && tracks[__track]) {
         if (__operation == TEXT("or")) {
             result = source_texture | __mask;
             c = true;
@@ -109,26 +112,191 @@ void UDynamicFilterChain::AddFilter(uint8 track, FString operation, uint8 mask,
     f.SetMask(mask);
     f.SetTerminate(terminate_subchain);
     __chain.Add(f); 
+    ++__revision;
 }
 
 
 
 void UDynamicFilterChain::Clear() {
     __chain.Empty();
+    ++__revision;
+}
+
+FFilterChainReport UDynamicFilterChain::Optimize() {
+    
+    // Filters of one subchain all read the same source and the last one to fire wins;
+    // a terminate hands the result on as the source of the next subchain.
+    // Each filter remembers its authored index, a fused one the index of the first
+    // half (the second one only fires after it anyway).
+    struct FSubchain
+    {
+        TArray<FFilter> filters;
+        TArray<int> origins;
+        bool terminated;
+    };
+    
+    __has_runtime_chain = false;
+    __report = FFilterChainReport();
+    FFilterChainReport& report = __report;
+    report.filters_before = __chain.Num();
+    
+    TArray<FSubchain> subchains;
+    subchains.Add({ {}, {}, false });
+    for (int i = 0; i < __chain.Num(); ++i) {
+        FFilter f = __chain[i];
+        FString op = f.GetOperation();
+        bool valid = (f.GetTrack() < BYTE_SIZE) && ((op == TEXT("or")) || (op == TEXT("and")) || (op == TEXT("xor")));
+        if (valid) {
+            subchains.Last().filters.Add(f);
+            subchains.Last().origins.Add(i);
+        }
+        else {
+            ++report.invalid_removed;
+        }
+        if (f.IsTerminate()) {
+            subchains.Last().terminated = true;
+            subchains.Add({ {}, {}, false });
+        }
+    }
+    
+    // shadowed: an earlier filter on the same track fires exactly when the later one does:
+    for (FSubchain& sub : subchains) {
+        for (int i = 0; i < sub.filters.Num(); ++i) {
+            for (int j = i + 1; j < sub.filters.Num(); ++j) {
+                if (sub.filters[j].GetTrack() == sub.filters[i].GetTrack()) {
+                    sub.filters.RemoveAt(i);
+                    sub.origins.RemoveAt(i--);
+                    ++report.shadowed_removed;
+                    break;
+                }
+            }
+        }
+    }
+    
+    // dead: bits that may be one in the source of each subchain, a filter whose
+    // track bit is always zero there can't fire. Bitwise, so it doesn't need a table:
+    uint8 may_be_one = 0xFF;
+    for (FSubchain& sub : subchains) {
+        uint8 next = may_be_one;
+        for (int i = 0; i < sub.filters.Num(); ++i) {
+            FFilter& f = sub.filters[i];
+            if ((may_be_one & (1 << f.GetTrack())) == 0) {
+                sub.filters.RemoveAt(i);
+                sub.origins.RemoveAt(i--);
+                ++report.dead_removed;
+                continue;
+            }
+            if (f.GetOperation() == TEXT("and"))
+                next |= may_be_one & f.GetMask();
+            else
+                next |= may_be_one | f.GetMask();
+        }
+        may_be_one = next;
+    }
+    
+    // empty subchains do nothing, their terminate included:
+    subchains.RemoveAll([](const FSubchain& sub) { return sub.filters.Num() == 0; });
+    
+    // fold two single-filter subchains with the same track and operation. The second one
+    // only sees sources the first one fired on, so it fires after it or never:
+    for (int s = 0; s + 1 < subchains.Num(); ++s) {
+        if ((subchains[s].filters.Num() != 1) || (subchains[s + 1].filters.Num() != 1))
+            continue;
+        
+        FFilter& a = subchains[s].filters[0];
+        FFilter& b = subchains[s + 1].filters[0];
+        if ((a.GetTrack() != b.GetTrack()) || (a.GetOperation() != b.GetOperation()))
+            continue;
+        
+        uint8 bit = 1 << a.GetTrack();
+        FString op = a.GetOperation();
+        if (op == TEXT("or")) {
+            a.SetMask(a.GetMask() | b.GetMask());
+            ++report.fused;
+        }
+        else if ((op == TEXT("and")) && (a.GetMask() & bit)) {
+            a.SetMask(a.GetMask() & b.GetMask());
+            ++report.fused;
+        }
+        else if ((op == TEXT("xor")) && !(a.GetMask() & bit)) {
+            a.SetMask(a.GetMask() ^ b.GetMask());
+            ++report.fused;
+        }
+        else {
+            ++report.dead_removed; // a clears the bit b needs.
+        }
+        subchains[s].terminated = subchains[s + 1].terminated;
+        subchains.RemoveAt(s + 1);
+        --s; // the folded filter may fold with the next one too.
+    }
+    
+    TArray<FFilter> optimized;
+    TArray<int> origins;
+    for (FSubchain& sub : subchains) {
+        for (int i = 0; i < sub.filters.Num(); ++i) {
+            sub.filters[i].SetTerminate((i == sub.filters.Num() - 1) && sub.terminated);
+            optimized.Add(sub.filters[i]);
+            origins.Add(sub.origins[i]);
+        }
+    }
+    
+    for (int t = 0; t < 256; ++t) {
+        if (__evaluate(optimized, uint8(t)) != __evaluate(__chain, uint8(t))) {
+            UE_LOG(LogTemp, Warning, TEXT("Dynamic filter chain: optimized chain differs for texture %d, kept as it was."), t);
+            report.filters_after = report.filters_before;
+            return report;
+        }
+    }
+    
+    report.verified = true;
+    report.filters_after = optimized.Num();
+    if (optimized.Num() != __chain.Num()) {
+        __runtime_chain = optimized;
+        __runtime_to_authored = origins;
+        __runtime_revision = __revision;
+        __has_runtime_chain = true;
+    }
+    return report;
+}
+
+uint8 UDynamicFilterChain::__evaluate(TArray<FFilter>& chain, uint8 source_texture) {
+    
+    uint8 result = source_texture;
+    uint8 src = source_texture;
+    for (int i = 0; i < chain.Num(); ++i) {
+        bool changed;
+        uint8 r = chain[i].Apply(src, changed);
+        if (changed) {
+            result = r;
+        }
+        if (chain[i].IsTerminate()) {
+            src = result;
+        }
+    }
+    return result;
 }
 
 
 uint8 UDynamicFilterChain::ApplyDynamicFilterChain(uint8 source_texture) {
     
+    uint32* hits = FFilterChainProfiler::IsEnabled()
+        ? FFilterChainProfiler::Get().BeginDynamicChain(this, __revision, __chain.Num()) : nullptr;
+    
+    // the optimized copy until the chain is edited again:
+    bool runtime = __has_runtime_chain && (__runtime_revision == __revision);
+    TArray<FFilter>& chain = runtime ? __runtime_chain : __chain;
+    
     uint8 result = source_texture;
     uint8 src = source_texture;
-    for (int i = 0; i < __chain.Num(); ++i) {
+    for (int i = 0; i < chain.Num(); ++i) {
         bool changed;
-        uint8 r = __chain[i].Apply(src, changed);
+        uint8 r = chain[i].Apply(src, changed);
         if (changed) {
             result = r;
+            if (hits != nullptr)
+                ++hits[runtime ? __runtime_to_authored[i] : i];
         }
-        if (__chain[i].IsTerminate()) {
+        if (chain[i].IsTerminate()) {
             src = result;
         }
     }
@@ -143,6 +311,9 @@ bool UDynamicFilterChain::IsAvailable() {
 }
 
 UDynamicFilterChain::UDynamicFilterChain() {
+    __revision = 0;
+    __runtime_revision = 0;
+    __has_runtime_chain = false;
     UE_LOG(LogTemp, Display, TEXT("Dynamic filter chain created."));
 }
 
@@ -59,6 +59,34 @@ struct FFilter
 };
 
 
+USTRUCT(BlueprintType)
+struct FFilterChainReport
+{
+    GENERATED_BODY()
+
+    public:
+
+    UPROPERTY(BlueprintReadOnly)    int filters_before;
+    UPROPERTY(BlueprintReadOnly)    int filters_after;
+    UPROPERTY(BlueprintReadOnly)    int invalid_removed;    // unknown operation or track > 7
+    UPROPERTY(BlueprintReadOnly)    int shadowed_removed;   // a later filter of the subchain has the same track
+    UPROPERTY(BlueprintReadOnly)    int dead_removed;       // track bit can't be set at that point
+    UPROPERTY(BlueprintReadOnly)    int fused;              // two single-filter subchains became one
+    UPROPERTY(BlueprintReadOnly)    bool verified;          // same result for all 256 textures
+
+    FFilterChainReport()
+    {
+        filters_before = 0;
+        filters_after = 0;
+        invalid_removed = 0;
+        shadowed_removed = 0;
+        dead_removed = 0;
+        fused = 0;
+        verified = false;
+    }
+};
+
+
 UCLASS(Blueprintable)
 class UDynamicFilterChain : public UObject
 {
@@ -70,16 +98,44 @@ class UDynamicFilterChain : public UObject
                                     
     UFUNCTION(BlueprintCallable)    void Clear();
     
+    UFUNCTION(BlueprintCallable)    FFilterChainReport Optimize();
+                                    // Builds a shorter equivalent runtime copy of the chain.
+                                    // The copy is checked against the original for all
+                                    // 256 textures and thrown away if anything differs.
+                                    // The authored filters stay as they are, profiler hits
+                                    // are counted against their indices.
+                                    // AAdaptiveMixer::Run calls it.
+                                    
+    UFUNCTION(BlueprintCallable)    FFilterChainReport GetOptimizeReport() { return __report; }
+                                    // What the last Optimize did.
+    
     UFUNCTION()
     uint8 ApplyDynamicFilterChain(uint8 source);
     
     UFUNCTION()
     bool IsAvailable();
+    
+    TArray<FFilter> GetFilters() { return __chain; }
+    void SetFilters(const TArray<FFilter>& filters) { __chain = filters; ++__revision; }
+    
+    uint32 GetRevision() { return __revision; } // changes whenever the chain does.
         
     private:
+    static uint8 __evaluate(TArray<FFilter>& chain, uint8 source);
+    
     UPROPERTY()
     TArray<FFilter> __chain;
     
+    UPROPERTY()
+    uint32 __revision;
+    
+    // Optimize output, used while __runtime_revision == __revision:
+    TArray<FFilter> __runtime_chain;
+    TArray<int> __runtime_to_authored;  // __chain index of each runtime filter
+    uint32 __runtime_revision;
+    bool __has_runtime_chain;
+    FFilterChainReport __report;
+    
     public:
     UDynamicFilterChain();
     ~UDynamicFilterChain();
@@ -0,0 +1,258 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "FilterChainProfiler.h"
+#include "AdaptiveMixer.h"
+#include "FilterChain.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+static TAutoConsoleVariable<int32> CVarProfileFilterChains(
+    TEXT("au.AdaptiveMixer.ProfileFilterChains"),
+    0,
+    TEXT("1 = count filter hits and texture transitions of adaptive mixers (see au.AdaptiveMixer.DumpFilterProfile)."),
+    ECVF_Default);
+
+static FAutoConsoleCommand DumpFilterProfileCommand(
+    TEXT("au.AdaptiveMixer.DumpFilterProfile"),
+    TEXT("Logs filter hits, static chain hits and the most frequent texture transitions."),
+    FConsoleCommandDelegate::CreateLambda([]() { FFilterChainProfiler::Get().Dump(); }));
+
+static FAutoConsoleCommand ExportFilterProfileCommand(
+    TEXT("au.AdaptiveMixer.ExportFilterProfile"),
+    TEXT("Writes the filter profile as CSV files. Optional argument: directory."),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args) {
+        FFilterChainProfiler::Get().ExportCSV(args.Num() > 0 ? args[0] : FString());
+    }));
+
+static FAutoConsoleCommand ResetFilterProfileCommand(
+    TEXT("au.AdaptiveMixer.ResetFilterProfile"),
+    TEXT("Clears all counters of the filter profile."),
+    FConsoleCommandDelegate::CreateLambda([]() { FFilterChainProfiler::Get().Reset(); }));
+
+constexpr int DUMP_TOP_TRANSITIONS = 16;
+
+FFilterChainProfiler& FFilterChainProfiler::Get() {
+    static FFilterChainProfiler profiler;
+    return profiler;
+}
+
+bool FFilterChainProfiler::IsEnabled() {
+    return CVarProfileFilterChains.GetValueOnGameThread() != 0;
+}
+
+uint32* FFilterChainProfiler::BeginDynamicChain(const UDynamicFilterChain* chain, uint32 revision, int filter_count) {
+
+    FChainHits& c = __dynamic_chains.FindOrAdd(chain);
+    if (c.name.IsEmpty() || (c.revision != revision)) {
+        // other filters at the same indices now, old counts would be credited to them:
+        c.name = chain->GetPathName();
+        c.revision = revision;
+        c.evaluations = 0;
+        c.hits.Reset();
+    }
+    if (c.hits.Num() < filter_count)
+        c.hits.AddZeroed(filter_count - c.hits.Num());
+    ++c.evaluations;
+    return c.hits.GetData();
+}
+
+void FFilterChainProfiler::CountStaticChain(uint8 filterchain_index, bool changed) {
+
+    ++__static_calls[filterchain_index];
+    if (changed)
+        ++__static_changes[filterchain_index];
+}
+
+void FFilterChainProfiler::RecordFilterPass(uint8 source, uint8 filtered) {
+
+    if (__source_filtered.Num() == 0)
+        __source_filtered.SetNumZeroed(PROFILE_TEXTURE_COUNT * PROFILE_TEXTURE_COUNT);
+    ++__source_filtered[source * PROFILE_TEXTURE_COUNT + filtered];
+}
+
+void FFilterChainProfiler::RecordTexture(const UObject* owner, uint8 texture, double time) {
+
+    FTextureVisit* visit = __visits.Find(owner);
+    if (visit == nullptr) {
+        __visits.Add(owner, { texture, time });
+        return;
+    }
+
+    if (visit->texture == texture)
+        return;
+
+    if (__transitions.Num() == 0)
+        __transitions.SetNumZeroed(PROFILE_TEXTURE_COUNT * PROFILE_TEXTURE_COUNT);
+    ++__transitions[visit->texture * PROFILE_TEXTURE_COUNT + texture];
+    __dwell[visit->texture] += time - visit->since;
+    visit->texture = texture;
+    visit->since = time;
+}
+
+void FFilterChainProfiler::EndTexture(const UObject* owner, double time) {
+
+    FTextureVisit visit;
+    if (__visits.RemoveAndCopyValue(owner, visit))
+        __dwell[visit.texture] += time - visit.since;
+}
+
+TArray<int> FFilterChainProfiler::GetFilterHits(const UDynamicFilterChain* chain) const {
+
+    TArray<int> result;
+    if (const FChainHits* c = __dynamic_chains.Find(chain)) {
+        for (uint32 h : c->hits) {
+            result.Add(int(h));
+        }
+    }
+    return result;
+}
+
+uint32 FFilterChainProfiler::GetStaticChainHits(uint8 filterchain_index) const {
+    return __static_calls[filterchain_index];
+}
+
+uint32 FFilterChainProfiler::GetSourceFilteredCount(uint8 source, uint8 filtered) const {
+    return __source_filtered.Num() > 0 ? __source_filtered[source * PROFILE_TEXTURE_COUNT + filtered] : 0;
+}
+
+uint32 FFilterChainProfiler::GetTransitionCount(uint8 from, uint8 to) const {
+    return __transitions.Num() > 0 ? __transitions[from * PROFILE_TEXTURE_COUNT + to] : 0;
+}
+
+double FFilterChainProfiler::GetDwellTime(uint8 texture) const {
+    return __dwell[texture];
+}
+
+void FFilterChainProfiler::Dump() const {
+
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("---- Filter chain profile ----"));
+
+    for (const TPair<TWeakObjectPtr<const UDynamicFilterChain>, FChainHits>& c : __dynamic_chains) {
+        UE_LOG(AdaptiveMixerLog, Display, TEXT("%s: %u evaluations"), *c.Value.name, c.Value.evaluations);
+        for (int i = 0; i < c.Value.hits.Num(); ++i) {
+            UE_LOG(AdaptiveMixerLog, Display, TEXT("    filter %2d: %u hits%s"), i, c.Value.hits[i],
+                c.Value.hits[i] == 0 ? TEXT("  <- never fired") : TEXT(""));
+        }
+    }
+
+    for (int i = 0; i < PROFILE_TEXTURE_COUNT; ++i) {
+        if (__static_calls[i] > 0) {
+            UE_LOG(AdaptiveMixerLog, Display, TEXT("static chain %3d: %u calls, %u changed the texture"),
+                i, __static_calls[i], __static_changes[i]);
+        }
+    }
+
+    if (__transitions.Num() > 0) {
+        TArray<int> cells;
+        for (int i = 0; i < __transitions.Num(); ++i) {
+            if (__transitions[i] > 0)
+                cells.Add(i);
+        }
+        cells.Sort([this](int a, int b) { return __transitions[a] > __transitions[b]; });
+        for (int i = 0; i < FMath::Min(cells.Num(), DUMP_TOP_TRANSITIONS); ++i) {
+            int from = cells[i] / PROFILE_TEXTURE_COUNT;
+            int to = cells[i] % PROFILE_TEXTURE_COUNT;
+            UE_LOG(AdaptiveMixerLog, Display, TEXT("texture %3d -> %3d: %u times (dwell in %d: %.1f s)"),
+                from, to, __transitions[cells[i]], from, __dwell[from]);
+        }
+    }
+}
+
+bool FFilterChainProfiler::ExportCSV(const FString& directory) const {
+
+    FString dir = directory.IsEmpty() ? FPaths::ProfilingDir() / TEXT("AdaptiveMixer") : directory;
+    bool ok = true;
+
+    FString filters = TEXT("chain,filter,evaluations,hits\n");
+    for (const TPair<TWeakObjectPtr<const UDynamicFilterChain>, FChainHits>& c : __dynamic_chains) {
+        for (int i = 0; i < c.Value.hits.Num(); ++i) {
+            filters += FString::Printf(TEXT("%s,%d,%u,%u\n"), *c.Value.name, i, c.Value.evaluations, c.Value.hits[i]);
+        }
+    }
+    ok &= FFileHelper::SaveStringToFile(filters, *(dir / TEXT("dynamic_filters.csv")));
+
+    FString statics = TEXT("filterchain_index,calls,changed\n");
+    for (int i = 0; i < PROFILE_TEXTURE_COUNT; ++i) {
+        if (__static_calls[i] > 0)
+            statics += FString::Printf(TEXT("%d,%u,%u\n"), i, __static_calls[i], __static_changes[i]);
+    }
+    ok &= FFileHelper::SaveStringToFile(statics, *(dir / TEXT("static_chains.csv")));
+
+    // matrices are sparse, only non-zero cells are written:
+    FString source_filtered = TEXT("source,filtered,count\n");
+    for (int i = 0; i < __source_filtered.Num(); ++i) {
+        if (__source_filtered[i] > 0) {
+            source_filtered += FString::Printf(TEXT("%d,%d,%u\n"),
+                i / PROFILE_TEXTURE_COUNT, i % PROFILE_TEXTURE_COUNT, __source_filtered[i]);
+        }
+    }
+    ok &= FFileHelper::SaveStringToFile(source_filtered, *(dir / TEXT("source_filtered.csv")));
+
+    FString transitions = TEXT("from,to,count\n");
+    for (int i = 0; i < __transitions.Num(); ++i) {
+        if (__transitions[i] > 0) {
+            transitions += FString::Printf(TEXT("%d,%d,%u\n"),
+                i / PROFILE_TEXTURE_COUNT, i % PROFILE_TEXTURE_COUNT, __transitions[i]);
+        }
+    }
+    ok &= FFileHelper::SaveStringToFile(transitions, *(dir / TEXT("transitions.csv")));
+
+    FString dwell = TEXT("texture,seconds\n");
+    for (int i = 0; i < PROFILE_TEXTURE_COUNT; ++i) {
+        if (__dwell[i] > 0.0)
+            dwell += FString::Printf(TEXT("%d,%.3f\n"), i, __dwell[i]);
+    }
+    ok &= FFileHelper::SaveStringToFile(dwell, *(dir / TEXT("dwell.csv")));
+
+    if (ok)
+        UE_LOG(AdaptiveMixerLog, Display, TEXT("Filter profile exported to %s."), *dir);
+    else
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Can't export the filter profile to %s."), *dir);
+    return ok;
+}
+
+void FFilterChainProfiler::Reset() {
+
+    __dynamic_chains.Empty();
+    FMemory::Memzero(__static_calls, sizeof(__static_calls));
+    FMemory::Memzero(__static_changes, sizeof(__static_changes));
+    __source_filtered.Empty();
+    __transitions.Empty();
+    FMemory::Memzero(__dwell, sizeof(__dwell));
+    __visits.Empty(); // every owner starts a new visit at its next texture.
+}
+
+
+void UFilterChainProfilerLibrary::SetFilterProfilingEnabled(bool enabled) {
+    CVarProfileFilterChains->Set(enabled ? 1 : 0, ECVF_SetByCode);
+}
+
+TArray<int> UFilterChainProfilerLibrary::GetFilterHits(UDynamicFilterChain* chain) {
+    return FFilterChainProfiler::Get().GetFilterHits(chain);
+}
+
+int UFilterChainProfilerLibrary::GetStaticChainHits(uint8 filterchain_index) {
+    return int(FFilterChainProfiler::Get().GetStaticChainHits(filterchain_index));
+}
+
+int UFilterChainProfilerLibrary::GetSourceFilteredCount(uint8 source, uint8 filtered) {
+    return int(FFilterChainProfiler::Get().GetSourceFilteredCount(source, filtered));
+}
+
+int UFilterChainProfilerLibrary::GetTransitionCount(uint8 from, uint8 to) {
+    return int(FFilterChainProfiler::Get().GetTransitionCount(from, to));
+}
+
+float UFilterChainProfilerLibrary::GetTextureDwellTime(uint8 texture) {
+    return float(FFilterChainProfiler::Get().GetDwellTime(texture));
+}
+
+bool UFilterChainProfilerLibrary::ExportFilterProfile(FString directory) {
+    return FFilterChainProfiler::Get().ExportCSV(directory);
+}
+
+void UFilterChainProfilerLibrary::ResetFilterProfile() {
+    FFilterChainProfiler::Get().Reset();
+}
@@ -0,0 +1,113 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "FilterChainProfiler.generated.h"
+
+class UDynamicFilterChain;
+
+constexpr int PROFILE_TEXTURE_COUNT = 256;
+
+// Opt-in coverage profiler for filter chains and textures (au.AdaptiveMixer.ProfileFilterChains 1).
+//
+// Counts how often every dynamic filter fires and how often every static chain is applied,
+// and records two 256 x 256 matrices: source texture -> filtered texture, and
+// texture -> next texture of each mixer, with the time spent in every texture.
+// Filters that never fire and textures never reached are candidates for pruning.
+//
+// Console:
+//     au.AdaptiveMixer.DumpFilterProfile               // to the log
+//     au.AdaptiveMixer.ExportFilterProfile <directory> // CSV files, Saved/Profiling/AdaptiveMixer by default
+//     au.AdaptiveMixer.ResetFilterProfile
+//
+// In the editor, UFilterChainProfilerLibrary reads the same data (e.g. from an editor utility widget).
+// Game thread only, like the filter chains themselves.
+
+class FFilterChainProfiler
+{
+    public:
+
+    static FFilterChainProfiler& Get();
+    static bool IsEnabled();
+
+    uint32* BeginDynamicChain(const UDynamicFilterChain* chain, uint32 revision, int filter_count);
+    // Counts one evaluation of chain, returns its per-filter hit counters.
+    // An edited chain (new revision) starts counting from zero again.
+
+    void CountStaticChain(uint8 filterchain_index, bool changed);
+
+    void RecordFilterPass(uint8 source, uint8 filtered);
+
+    void RecordTexture(const UObject* owner, uint8 texture, double time);
+    void EndTexture(const UObject* owner, double time);  // owner stopped, closes its dwell time.
+
+    TArray<int> GetFilterHits(const UDynamicFilterChain* chain) const;
+    uint32 GetStaticChainHits(uint8 filterchain_index) const;
+    uint32 GetSourceFilteredCount(uint8 source, uint8 filtered) const;
+    uint32 GetTransitionCount(uint8 from, uint8 to) const;
+    double GetDwellTime(uint8 texture) const;
+
+    void Dump() const;
+    bool ExportCSV(const FString& directory) const;
+    void Reset();
+
+    private:
+
+    struct FChainHits
+    {
+        FString name;
+        uint32 revision;    // UDynamicFilterChain::GetRevision the counts belong to
+        uint32 evaluations;
+        TArray<uint32> hits;
+    };
+
+    struct FTextureVisit
+    {
+        uint8 texture;
+        double since;
+    };
+
+    TMap<TWeakObjectPtr<const UDynamicFilterChain>, FChainHits> __dynamic_chains;
+    uint32 __static_calls[PROFILE_TEXTURE_COUNT] = {};
+    uint32 __static_changes[PROFILE_TEXTURE_COUNT] = {};
+    TArray<uint32> __source_filtered;   // [source * 256 + filtered], allocated on first use
+    TArray<uint32> __transitions;       // [from * 256 + to]
+    double __dwell[PROFILE_TEXTURE_COUNT] = {};
+    TMap<const UObject*, FTextureVisit> __visits;
+};
+
+
+UCLASS()
+class UFilterChainProfilerLibrary : public UBlueprintFunctionLibrary
+{
+    GENERATED_BODY()
+
+    public:
+
+    UFUNCTION(BlueprintCallable, Category = "AdaptiveMixer|Profiling")
+    static void SetFilterProfilingEnabled(bool enabled);
+
+    UFUNCTION(BlueprintPure, Category = "AdaptiveMixer|Profiling")
+    static TArray<int> GetFilterHits(UDynamicFilterChain* chain); // one count per filter, in chain order.
+
+    UFUNCTION(BlueprintPure, Category = "AdaptiveMixer|Profiling")
+    static int GetStaticChainHits(uint8 filterchain_index);
+
+    UFUNCTION(BlueprintPure, Category = "AdaptiveMixer|Profiling")
+    static int GetSourceFilteredCount(uint8 source, uint8 filtered);
+
+    UFUNCTION(BlueprintPure, Category = "AdaptiveMixer|Profiling")
+    static int GetTransitionCount(uint8 from, uint8 to);
+
+    UFUNCTION(BlueprintPure, Category = "AdaptiveMixer|Profiling")
+    static float GetTextureDwellTime(uint8 texture);
+
+    UFUNCTION(BlueprintCallable, Category = "AdaptiveMixer|Profiling")
+    static bool ExportFilterProfile(FString directory);
+
+    UFUNCTION(BlueprintCallable, Category = "AdaptiveMixer|Profiling")
+    static void ResetFilterProfile();
+};
@@ -0,0 +1,84 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "IntensityVector.h"
+
+static_assert(PTRN_COUNT % 4 == 0, "Evaluate() processes stems in groups of 4.");
+
+void UIntensityVector::SetResponseCurve(uint8 pattern, uint8 parameter, float lower, float upper,
+    float min_gain, float max_gain) {
+
+    if ((pattern >= PTRN_COUNT) || (parameter >= INTENSITY_PARAM_COUNT))
+        return;
+
+    float range = upper - lower;
+    if (FMath::Abs(range) < KINDA_SMALL_NUMBER)
+        range = KINDA_SMALL_NUMBER; // a step.
+
+    min_gain = FMath::Clamp(min_gain, 0.0f, 1.0f);
+    max_gain = FMath::Clamp(max_gain, 0.0f, 1.0f);
+
+    __curve_parameter[pattern] = parameter;
+    __curve_lower[pattern] = lower;
+    __curve_scale[pattern] = 1.0f / range;
+    __curve_min_gain[pattern] = min_gain;
+    __curve_gain_span[pattern] = max_gain - min_gain;
+}
+
+void UIntensityVector::SetParameter(uint8 parameter, float value) {
+
+    if (parameter >= INTENSITY_PARAM_COUNT)
+        return;
+
+    __parameters[parameter] = value;
+}
+
+float UIntensityVector::GetParameter(uint8 parameter) {
+
+    if (parameter >= INTENSITY_PARAM_COUNT)
+        return 0.0f;
+
+    return __parameters[parameter];
+}
+
+void UIntensityVector::Clear() {
+
+    for (int i = 0; i < INTENSITY_PARAM_COUNT; ++i) {
+        __parameters[i] = 0.0f;
+    }
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        __curve_parameter[i] = 0;
+        __curve_lower[i] = 0.0f;
+        __curve_scale[i] = 1.0f;
+        __curve_min_gain[i] = 1.0f;
+        __curve_gain_span[i] = 0.0f;
+    }
+}
+
+void UIntensityVector::Evaluate(float gains[PTRN_COUNT]) {
+
+    // gather the inputs, then: gain = min_gain + span * clamp((x - lower) * scale, 0, 1)
+    float inputs[PTRN_COUNT];
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        inputs[i] = __parameters[__curve_parameter[i]];
+    }
+
+    const VectorRegister zero = VectorZero();
+    const VectorRegister one = VectorOne();
+    for (int i = 0; i < PTRN_COUNT; i += 4) {
+        VectorRegister t = VectorMultiply(VectorSubtract(VectorLoad(&inputs[i]), VectorLoad(&__curve_lower[i])),
+            VectorLoad(&__curve_scale[i]));
+        t = VectorMin(VectorMax(t, zero), one);
+        VectorRegister g = VectorMultiplyAdd(t, VectorLoad(&__curve_gain_span[i]), VectorLoad(&__curve_min_gain[i]));
+        VectorStore(g, &gains[i]);
+    }
+}
+
+UIntensityVector::UIntensityVector() {
+    Clear();
+    UE_LOG(LogTemp, Display, TEXT("Intensity vector created."));
+}
+
+UIntensityVector::~UIntensityVector() {
+    UE_LOG(LogTemp, Display, TEXT("Intensity vector destroyed."));
+}
@@ -0,0 +1,46 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MixerConstants.h"
+#include "IntensityVector.generated.h"
+
+constexpr uint8 INTENSITY_PARAM_COUNT = 4;
+
+UCLASS(Blueprintable)
+class UIntensityVector : public UObject
+{
+    GENERATED_BODY()
+
+    public:
+    UFUNCTION(BlueprintCallable)    void SetResponseCurve(uint8 pattern, uint8 parameter, float lower, float upper,
+                                    float min_gain = 0.0f, float max_gain = 1.0f);
+                                    // Pattern gain goes from min_gain (parameter <= lower)
+                                    // to max_gain (parameter >= upper). Swap lower and upper
+                                    // to make the pattern fade out as the parameter grows.
+
+    UFUNCTION(BlueprintCallable)    void SetParameter(uint8 parameter, float value);
+    UFUNCTION(BlueprintCallable)    float GetParameter(uint8 parameter);
+
+    UFUNCTION(BlueprintCallable)    void Clear();
+                                    // Every pattern back to constant gain 1.0.
+
+    void Evaluate(float gains[]);   // Writes PTRN_COUNT gains, 4 stems per vector op.
+
+    private:
+    UPROPERTY()     float __parameters[INTENSITY_PARAM_COUNT];
+
+    // Curves are kept as structure of arrays, so Evaluate can load 4 stems at once:
+    UPROPERTY()     uint8 __curve_parameter[PTRN_COUNT];
+    UPROPERTY()     float __curve_lower[PTRN_COUNT];
+    UPROPERTY()     float __curve_scale[PTRN_COUNT];      // 1 / (upper - lower)
+    UPROPERTY()     float __curve_min_gain[PTRN_COUNT];
+    UPROPERTY()     float __curve_gain_span[PTRN_COUNT];  // max_gain - min_gain
+
+    public:
+    UIntensityVector();
+    ~UIntensityVector();
+
+};
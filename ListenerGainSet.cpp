@@ -0,0 +1,19 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "ListenerGainSet.h"
+
+FListenerGainSet::FListenerGainSet() {
+
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        volumes[i] = 1.0f;
+    }
+}
+
+void FListenerGainSet::MaxGains(uint8 processed_texture, float gains[PTRN_COUNT]) const {
+
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (processed_texture & (1 << i))
+            gains[i] = FMath::Max(gains[i], volumes[i]);
+    }
+}
@@ -0,0 +1,26 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MixerConstants.h"
+
+constexpr int MAX_LISTENER_SETS = 8;       // the mixer's own texture included
+
+// Texture and pattern gains of one more local player on a shared mixer (split-screen).
+// The stems are decoded once; every set asks for its gains and each stem plays at
+// the loudest one asked for. UE4 renders a world through one output device, so the
+// sets can't go to separate outputs -- all players hear the combined mix.
+
+struct FListenerGainSet
+{
+    bool used = false;
+    uint8 texture = 0;
+    float volumes[PTRN_COUNT];
+
+    FListenerGainSet();
+
+    void MaxGains(uint8 processed_texture, float gains[PTRN_COUNT]) const;
+    // gains[i] = max(gains[i], volumes[i]) for every pattern of processed_texture.
+};
@@ -0,0 +1,79 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "MixerAsync.h"
+#include "AdaptiveMixer.h"
+
+UMixerTransitionAsyncAction* UMixerTransitionAsyncAction::__create(AAdaptiveMixer* mixer, EMixerTransition kind) {
+
+    UMixerTransitionAsyncAction* action = NewObject<UMixerTransitionAsyncAction>();
+    action->__mixer = mixer;
+    action->__kind = kind;
+    if (mixer != nullptr)
+        action->RegisterWithGameInstance(mixer);
+    return action;
+}
+
+UMixerTransitionAsyncAction* UMixerTransitionAsyncAction::RunAndWait(AAdaptiveMixer* mixer, uint8 initial_texture) {
+
+    UMixerTransitionAsyncAction* action = __create(mixer, EMixerTransition::Run);
+    action->__texture = initial_texture;
+    return action;
+}
+
+UMixerTransitionAsyncAction* UMixerTransitionAsyncAction::PlayNewTextureAfterBridgeAndWait(AAdaptiveMixer* mixer,
+    uint8 new_texture, int bridge_index, float fade_out_ratio, float fade_in_ratio, float bridge_volume) {
+
+    UMixerTransitionAsyncAction* action = __create(mixer, EMixerTransition::Bridge);
+    action->__texture = new_texture;
+    action->__index = bridge_index;
+    action->__fade_out_ratio = fade_out_ratio;
+    action->__fade_in_ratio = fade_in_ratio;
+    action->__volume = bridge_volume;
+    return action;
+}
+
+UMixerTransitionAsyncAction* UMixerTransitionAsyncAction::PlayStingerAndWait(AAdaptiveMixer* mixer, int index, float stinger_volume) {
+
+    UMixerTransitionAsyncAction* action = __create(mixer, EMixerTransition::Stinger);
+    action->__index = index;
+    action->__volume = stinger_volume;
+    return action;
+}
+
+void UMixerTransitionAsyncAction::Activate() {
+
+    AAdaptiveMixer* mixer = __mixer.Get();
+    if (mixer == nullptr) {
+        __onLanded(false);
+        return;
+    }
+
+    TWeakObjectPtr<UMixerTransitionAsyncAction> weak_this(this);
+    TFunction<void(bool)> on_landed = [weak_this](bool landed) {
+        if (UMixerTransitionAsyncAction* action = weak_this.Get())
+            action->__onLanded(landed);
+    };
+
+    switch (__kind) {
+        case EMixerTransition::Run:
+            mixer->RunAndNotify(__texture, MoveTemp(on_landed));
+            break;
+        case EMixerTransition::Bridge:
+            mixer->PlayNewTextureAfterBridgeAndNotify(__texture, __index, __fade_out_ratio, __fade_in_ratio,
+                __volume, MoveTemp(on_landed));
+            break;
+        case EMixerTransition::Stinger:
+            mixer->PlayStingerAndNotify(__index, __volume, MoveTemp(on_landed));
+            break;
+    }
+}
+
+void UMixerTransitionAsyncAction::__onLanded(bool landed) {
+
+    if (landed)
+        Landed.Broadcast();
+    else
+        Cancelled.Broadcast();
+    SetReadyToDestroy();
+}
@@ -0,0 +1,72 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "MixerAsync.generated.h"
+
+class AAdaptiveMixer;
+
+// Transitions a caller can wait for. A transition has landed when it is audible in full:
+//
+//     Run         the first texture has faded in
+//     Bridge      the bridge is over and the new texture has faded in
+//     Stinger     the stinger has played to its end
+//
+// It is cut off by Stop, or by a newer transition of the same kind.
+
+enum class EMixerTransition : uint8
+{
+    Run,
+    Bridge,
+    Stinger
+};
+
+struct FMixerPendingTransition
+{
+    EMixerTransition kind;
+    uint32 serial;                          // the start it waits for, see AAdaptiveMixer::__transitionSerial
+    float land_time;                        // world audio time
+    TFunction<void(bool)> on_landed;        // true = landed, false = cut off
+};
+
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FMixerTransitionPin);
+
+UCLASS()
+class UMixerTransitionAsyncAction : public UBlueprintAsyncActionBase
+{
+    GENERATED_BODY()
+
+    public:
+
+    UFUNCTION(BlueprintCallable, Category = "AdaptiveMixer", meta = (BlueprintInternalUseOnly = "true"))
+    static UMixerTransitionAsyncAction* RunAndWait(AAdaptiveMixer* mixer, uint8 initial_texture);
+
+    UFUNCTION(BlueprintCallable, Category = "AdaptiveMixer", meta = (BlueprintInternalUseOnly = "true"))
+    static UMixerTransitionAsyncAction* PlayNewTextureAfterBridgeAndWait(AAdaptiveMixer* mixer,
+        uint8 new_texture, int bridge_index, float fade_out_ratio, float fade_in_ratio, float bridge_volume = 1.0f);
+
+    UFUNCTION(BlueprintCallable, Category = "AdaptiveMixer", meta = (BlueprintInternalUseOnly = "true"))
+    static UMixerTransitionAsyncAction* PlayStingerAndWait(AAdaptiveMixer* mixer, int index, float stinger_volume = 1.0f);
+
+    UPROPERTY(BlueprintAssignable)  FMixerTransitionPin Landed;
+    UPROPERTY(BlueprintAssignable)  FMixerTransitionPin Cancelled;   // couldn't start, or was cut off
+
+    virtual void Activate() override;
+
+    private:
+
+    static UMixerTransitionAsyncAction* __create(AAdaptiveMixer* mixer, EMixerTransition kind);
+    void __onLanded(bool landed);
+
+    TWeakObjectPtr<AAdaptiveMixer> __mixer;
+    EMixerTransition __kind;
+    uint8 __texture = 0;
+    int __index = 0;
+    float __fade_out_ratio = 0.0f;
+    float __fade_in_ratio = 0.0f;
+    float __volume = 1.0f;
+};
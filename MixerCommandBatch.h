@@ -0,0 +1,44 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MixerCommandBatch.generated.h"
+
+// Everything a designer graph usually does in one go.
+// Applied by AAdaptiveMixer::ApplyCommandBatch with a single decode.
+// Order: texture -> or_mask -> and_mask -> volumes -> stinger.
+
+USTRUCT(BlueprintType)
+struct FMixerCommandBatch
+{
+    GENERATED_BODY()
+
+    public:
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)     bool set_texture;
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)     uint8 texture;
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)     uint8 or_mask;          // 0000 0000 = nothing to insert
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)     uint8 and_mask;         // 1111 1111 = nothing to eject
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)     TArray<float> pattern_volumes;
+                                                    // Index = pattern; negative entries are left unchanged.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)     float master_volume;    // negative = unchanged
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)     float fade_time;        // negative = score fade time
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)     int stinger_index;      // negative = no stinger
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)     float stinger_volume;
+
+    FMixerCommandBatch()
+    {
+        set_texture = false;
+        texture = 0;
+        or_mask = 0;
+        and_mask = 255;
+        master_volume = -1.0f;
+        fade_time = -1.0f;
+        stinger_index = -1;
+        stinger_volume = 1.0f;
+    }
+};
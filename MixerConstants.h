@@ -0,0 +1,11 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Patterns (stems) of a score; every per-stem array in the mixer has this many.
+constexpr uint8 PTRN_COUNT = 8;
+
+constexpr float GAIN_EPSILON = 0.001f; // smaller gain changes are not sent to audio.
@@ -0,0 +1,115 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "MixerControlLog.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/MemoryReader.h"
+
+constexpr uint32 CONTROL_LOG_MAGIC = 0x4C434D41; // "AMCL"
+constexpr uint32 CONTROL_LOG_VERSION = 2;   // 2: object path per event
+
+void FMixerControlLog::Begin(uint64 frame, double audio_clock) {
+
+    __events.Empty();
+    __first_frame = frame;
+    __first_audio_clock = audio_clock;
+    __is_recording = true;
+}
+
+void FMixerControlLog::End() {
+    __is_recording = false;
+}
+
+void FMixerControlLog::Record(EMixerControlOp op, uint64 frame, double audio_clock, const TArray<float>& args,
+    const FString& object_path) {
+
+    if (!__is_recording)
+        return;
+
+    FMixerControlEvent e;
+    e.op = op;
+    e.frame = uint32(frame - __first_frame);
+    e.audio_time = float(audio_clock - __first_audio_clock);
+    e.args = args;
+    e.object_path = object_path;
+    __events.Add(e);
+}
+
+// Layout: magic, version, count, then per event:
+// op (1 byte), frame delta (packed int), audio time (float), arg count (1 byte), args (floats),
+// object path (FString, version 2 on).
+
+bool FMixerControlLog::Save(const FString& path) const {
+
+    TArray<uint8> bytes;
+    FMemoryWriter writer(bytes);
+
+    uint32 magic = CONTROL_LOG_MAGIC;
+    uint32 version = CONTROL_LOG_VERSION;
+    int32 count = __events.Num();
+    writer << magic << version << count;
+
+    uint32 previous_frame = 0;
+    for (const FMixerControlEvent& e : __events) {
+        uint8 op = uint8(e.op);
+        uint32 frame_delta = e.frame - previous_frame;
+        float audio_time = e.audio_time;
+        uint8 args_count = uint8(FMath::Min(e.args.Num(), 255));
+        writer << op;
+        writer.SerializeIntPacked(frame_delta);
+        writer << audio_time << args_count;
+        for (int i = 0; i < args_count; ++i) {
+            float arg = e.args[i];
+            writer << arg;
+        }
+        FString object_path = e.object_path;
+        writer << object_path;
+        previous_frame = e.frame;
+    }
+
+    return FFileHelper::SaveArrayToFile(bytes, *path);
+}
+
+bool FMixerControlLog::Load(const FString& path) {
+
+    TArray<uint8> bytes;
+    if (!FFileHelper::LoadFileToArray(bytes, *path))
+        return false;
+
+    FMemoryReader reader(bytes);
+    uint32 magic = 0;
+    uint32 version = 0;
+    int32 count = 0;
+    reader << magic << version << count;
+    if ((magic != CONTROL_LOG_MAGIC) || (version < 1) || (version > CONTROL_LOG_VERSION) || (count < 0))
+        return false;
+
+    __events.Empty(count);
+    uint32 frame = 0;
+    for (int n = 0; n < count; ++n) {
+        uint8 op = 0;
+        uint32 frame_delta = 0;
+        uint8 args_count = 0;
+        FMixerControlEvent e;
+        reader << op;
+        reader.SerializeIntPacked(frame_delta);
+        reader << e.audio_time << args_count;
+        e.args.SetNumUninitialized(args_count);
+        for (int i = 0; i < args_count; ++i) {
+            reader << e.args[i];
+        }
+        if (version >= 2)
+            reader << e.object_path;
+        if (reader.IsError() || (op >= uint8(EMixerControlOp::Count)))
+            return false;
+
+        frame += frame_delta;
+        e.op = EMixerControlOp(op);
+        e.frame = frame;
+        __events.Add(e);
+    }
+
+    __is_recording = false;
+    return true;
+}
@@ -0,0 +1,86 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Compact binary log of the mixer's public control calls.
+// Recorded by AAdaptiveMixer::StartControlRecording / StopControlRecording,
+// re-driven by AAdaptiveMixer::ReplayControlEvent (see -Replay= in AdaptiveMixerRenderCommandlet.h),
+// which schedules on audio_time; frame is kept for reading the log against a frame capture.
+// Setup calls (InitializeMixer, filter chains, response curves, arbitration and texture
+// rules) are not part of the stream; the calls the arbiter and the rules make are.
+// Object arguments are logged by path: AddScoreLayer's score and a custom fade curve
+// replay only if that path loads (assets). A snapshot of the score the mixer has loaded
+// is logged without a path and restores onto whatever score the replaying mixer has.
+
+enum class EMixerControlOp : uint8
+{
+    Run,
+    Stop,
+    PlayNewTexture,
+    PlayNewTextureAfterBridge,
+    PlayStinger,
+    SetPatternVolume,
+    SetAllPatternsVolume,
+    InitializeAllPatternsVolume,
+    SetMasterVolume,
+    ApplyCommandBatch,
+    SetIntensityMode,
+    SetIntensity,
+    Prepare,
+    RestoreSnapshot,
+    SetFadeEngine,
+    AddScoreLayer,
+    RemoveScoreLayer,
+    StartLayer,
+    StopLayer,
+    SetLayerTexture,
+    SetLayerVolume,
+    SetBarLength,
+    AddListenerSet,
+    RemoveListenerSet,
+    SetListenerTexture,
+    SetListenerPatternVolume,
+
+    Count
+};
+
+struct FMixerControlEvent
+{
+    EMixerControlOp op;
+    uint32 frame;           // relative to the first recorded frame
+    float audio_time;       // audio clock seconds, relative to the start of recording
+    TArray<float> args;     // call arguments, in declaration order
+    FString object_path;    // path of an object argument, empty if none
+
+    float Arg(int index, float default_value = 0.0f) const
+    {
+        return index < args.Num() ? args[index] : default_value;
+    }
+};
+
+class FMixerControlLog
+{
+    public:
+
+    void Begin(uint64 frame, double audio_clock);
+    void End();
+    bool IsRecording() const { return __is_recording; }
+
+    void Record(EMixerControlOp op, uint64 frame, double audio_clock, const TArray<float>& args,
+        const FString& object_path = FString());
+
+    bool Save(const FString& path) const;
+    bool Load(const FString& path);
+
+    const TArray<FMixerControlEvent>& GetEvents() const { return __events; }
+
+    private:
+
+    TArray<FMixerControlEvent> __events;
+    uint64 __first_frame = 0;
+    double __first_audio_clock = 0.0;
+    bool __is_recording = false;
+};
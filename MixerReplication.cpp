@@ -0,0 +1,106 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "MixerReplication.h"
+#include "AdaptiveMixer.h"
+#include "HAL/IConsoleManager.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+
+static TAutoConsoleVariable<float> CVarReplicationSeekTolerance(
+    TEXT("au.AdaptiveMixer.ReplicationSeekTolerance"),
+    0.05f,
+    TEXT("Seconds a client mixer may drift from the server transport before its stems are seeked."),
+    ECVF_Default);
+
+bool FMixerReplicatedTransport::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess) {
+
+    uint8 running_bit = running ? 1 : 0;
+    Ar.SerializeBits(&running_bit, 1);
+    running = running_bit != 0;
+
+    uint32 id = score_id;
+    Ar.SerializeIntPacked(id);
+    score_id = uint16(id);
+
+    Ar << start_audio_time;
+
+    bOutSuccess = true;
+    return true;
+}
+
+bool FMixerPackedIndex::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess) {
+
+    Ar.SerializeIntPacked(value);
+    bOutSuccess = true;
+    return true;
+}
+
+TMap<TWeakObjectPtr<const UWorld>, FMixerReplication::FScoreIds>& FMixerReplication::__worlds() {
+    static TMap<TWeakObjectPtr<const UWorld>, FScoreIds> worlds;
+    return worlds;
+}
+
+const FMixerReplication::FScoreIds* FMixerReplication::__scores(const UWorld* world) {
+    return world ? __worlds().Find(world) : nullptr;
+}
+
+bool FMixerReplication::RegisterScore(const UWorld* world, UAdaptiveScore* score, uint16 score_id) {
+
+    if ((world == nullptr) || (score == nullptr) || (score_id == 0)) {
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Replicated scores need a world, a score and an id from 1 to 65535."));
+        return false;
+    }
+
+    // worlds torn down since (map travel, ended PIE sessions) take their ids with them:
+    for (TMap<TWeakObjectPtr<const UWorld>, FScoreIds>::TIterator it = __worlds().CreateIterator(); it; ++it) {
+        if (!it.Key().IsValid())
+            it.RemoveCurrent();
+    }
+
+    TWeakObjectPtr<UAdaptiveScore>& slot = __worlds().FindOrAdd(world).FindOrAdd(score_id);
+    if (slot.IsValid() && (slot.Get() != score))
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Score id %d is taken over by %s."), score_id, *score->GetName());
+    slot = score;
+    return true;
+}
+
+UAdaptiveScore* FMixerReplication::FindScore(const UWorld* world, uint16 score_id) {
+
+    const FScoreIds* scores = __scores(world);
+    const TWeakObjectPtr<UAdaptiveScore>* slot = scores ? scores->Find(score_id) : nullptr;
+    return slot ? slot->Get() : nullptr;
+}
+
+uint16 FMixerReplication::FindScoreId(const UWorld* world, const UAdaptiveScore* score) {
+
+    const FScoreIds* scores = __scores(world);
+    if ((score == nullptr) || (scores == nullptr))
+        return 0;
+
+    for (const TPair<uint16, TWeakObjectPtr<UAdaptiveScore>>& s : *scores) {
+        if (s.Value.Get() == score)
+            return s.Key;
+    }
+    return 0;
+}
+
+float FMixerReplication::GetSeekTolerance() {
+    return FMath::Max(CVarReplicationSeekTolerance.GetValueOnGameThread(), 0.0f);
+}
+
+float FMixerReplication::GetOneWayLatency(const UWorld* world) {
+
+    APlayerController* controller = world ? world->GetFirstPlayerController() : nullptr;
+    APlayerState* player_state = controller ? controller->PlayerState : nullptr;
+    return player_state ? player_state->ExactPing * 0.001f * 0.5f : 0.0f; // ExactPing is ms
+}
+
+uint8 FMixerReplication::Quantize(float unit_value) {
+    return uint8(FMath::RoundToInt(FMath::Clamp(unit_value, 0.0f, 1.0f) * 255.0f));
+}
+
+float FMixerReplication::Dequantize(uint8 packed) {
+    return float(packed) / 255.0f;
+}
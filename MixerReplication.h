@@ -0,0 +1,95 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MixerReplication.generated.h"
+
+class UAdaptiveScore;
+class UPackageMap;
+
+constexpr float SERVER_CLOCK_INTERVAL = 1.0f; // seconds between server clock samples
+
+// Which score a server mixer plays and where its transport is. The texture travels
+// on its own (one byte, only when it changes), bridges and stingers are multicast.
+//
+// Packed: running 1 bit, score id 1-3 bytes (SerializeIntPacked), transport 32 bits.
+//
+// Transport times are on the server's world audio clock. Clients follow that clock
+// through AAdaptiveMixer::__rep_server_audio_time, a sample sent every
+// SERVER_CLOCK_INTERVAL and advanced by half the round trip when it arrives.
+
+USTRUCT()
+struct FMixerReplicatedTransport
+{
+    GENERATED_BODY()
+
+    uint16 score_id = 0;                // FMixerReplication registry, 0 = none
+    bool running = false;
+    float start_audio_time = 0.0f;      // server world audio time of transport position 0
+
+    bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+
+    bool operator==(const FMixerReplicatedTransport& other) const {
+        return (score_id == other.score_id) && (running == other.running) &&
+            (start_audio_time == other.start_audio_time);
+    }
+};
+
+template<>
+struct TStructOpsTypeTraits<FMixerReplicatedTransport> : public TStructOpsTypeTraitsBase2<FMixerReplicatedTransport>
+{
+    enum
+    {
+        WithNetSerializer = true,
+        WithIdenticalViaEquality = true,
+    };
+};
+
+// Bridge or stinger index of a multicast, 1 byte up to 127 (SerializeIntPacked).
+
+USTRUCT()
+struct FMixerPackedIndex
+{
+    GENERATED_BODY()
+
+    uint32 value = 0;
+
+    bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FMixerPackedIndex> : public TStructOpsTypeTraitsBase2<FMixerPackedIndex>
+{
+    enum
+    {
+        WithNetSerializer = true,
+    };
+};
+
+// Scores are created at runtime (UAdaptiveScore::InitializeScore), so they have no
+// network name. Every machine registers its own instance under the same id. The
+// registry is kept per UWorld: PIE runs the listen server and its clients in one
+// process, each in a world of its own.
+
+class FMixerReplication
+{
+    public:
+
+    static bool RegisterScore(const UWorld* world, UAdaptiveScore* score, uint16 score_id);
+    static UAdaptiveScore* FindScore(const UWorld* world, uint16 score_id);
+    static uint16 FindScoreId(const UWorld* world, const UAdaptiveScore* score); // 0 = not registered
+
+    static float GetSeekTolerance(); // au.AdaptiveMixer.ReplicationSeekTolerance
+    static float GetOneWayLatency(const UWorld* world); // client: half the round trip of the local player, seconds
+
+    static uint8 Quantize(float unit_value);     // 0..1 -> 8 bits, for multicast arguments
+    static float Dequantize(uint8 packed);
+
+    private:
+
+    typedef TMap<uint16, TWeakObjectPtr<UAdaptiveScore>> FScoreIds;
+    static TMap<TWeakObjectPtr<const UWorld>, FScoreIds>& __worlds();
+    static const FScoreIds* __scores(const UWorld* world);
+};
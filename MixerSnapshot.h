@@ -0,0 +1,57 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AdaptiveScore.h"
+#include "FilterChain.h"
+#include "MixerSnapshot.generated.h"
+
+// Everything needed to bring a mixer back where it was, e.g. after level streaming or
+// seamless travel rebuilt the actor. Keep it in the GameInstance (or a USaveGame).
+// The score is not held by the snapshot: RestoreSnapshot looks it up by its
+// replication id (AAdaptiveMixer::RegisterReplicatedScore in the new world), then by
+// path -- still in memory (e.g. outered to the GameInstance) or a score asset.
+// Made by AAdaptiveMixer::CaptureSnapshot, applied by AAdaptiveMixer::RestoreSnapshot.
+
+USTRUCT(BlueprintType)
+struct FMixerSnapshot
+{
+    GENERATED_BODY()
+
+    public:
+
+    UPROPERTY(BlueprintReadOnly)    TSoftObjectPtr<UAdaptiveScore> score;
+    UPROPERTY(BlueprintReadOnly)    int score_id;               // 0 = wasn't registered for replication
+    UPROPERTY()                     TArray<FFilter> dynamic_filters;
+
+    UPROPERTY(BlueprintReadOnly)    bool was_running;
+    UPROPERTY(BlueprintReadOnly)    uint8 texture;
+    UPROPERTY(BlueprintReadOnly)    TArray<float> pattern_volumes;
+    UPROPERTY(BlueprintReadOnly)    float master_volume;
+    UPROPERTY(BlueprintReadOnly)    float playback_position;    // seconds into the pattern loop
+
+    // a bridge that was playing (patterns are silent under it):
+    UPROPERTY(BlueprintReadOnly)    bool bridge_pending;
+    UPROPERTY(BlueprintReadOnly)    int bridge_index;
+    UPROPERTY(BlueprintReadOnly)    float bridge_volume;
+    UPROPERTY(BlueprintReadOnly)    float bridge_position;      // seconds into the bridge
+    UPROPERTY(BlueprintReadOnly)    float bridge_timer_remaining;
+    UPROPERTY(BlueprintReadOnly)    float bridge_crossfade_time;
+
+    FMixerSnapshot()
+    {
+        score_id = 0;
+        was_running = false;
+        texture = 0;
+        master_volume = 1.0f;
+        playback_position = 0.0f;
+        bridge_pending = false;
+        bridge_index = -1;
+        bridge_volume = 1.0f;
+        bridge_position = 0.0f;
+        bridge_timer_remaining = 0.0f;
+        bridge_crossfade_time = 0.0f;
+    }
+};
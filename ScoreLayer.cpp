@@ -0,0 +1,156 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "ScoreLayer.h"
+#include "GameFramework/Actor.h"
+
+bool UScoreLayer::Initialize(AActor* owner, UAdaptiveScore* score, float layer_volume) {
+
+    if ((owner == nullptr) || (score == nullptr))
+        return false;
+
+    __score = score;
+    __loop_length = score->GetLoopLength();
+    __filterchain_index = score->GetFilterchainIndex();
+    __volume = FMath::Clamp(layer_volume, 0.0f, 1.0f);
+
+    TArray<USoundCue*> patterns = score->GetPatternCues();
+    int initialized_patterns = 0;
+
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        USoundCue* cue = i < patterns.Num() ? patterns[i] : nullptr;
+        __validation[i] = 0;
+        __applied_gains[i] = 0.0f;
+        if (!IsValid(cue))
+            continue;
+
+        UAudioComponent* component = NewObject<UAudioComponent>(owner);
+        component->bAutoActivate = false;
+        component->bAutoDestroy = false;
+        component->bIsMusic = true;
+        component->bStopWhenOwnerDestroyed = true;
+        component->SetupAttachment(owner->GetRootComponent());
+        component->RegisterComponent();
+        component->SetSound(cue);
+        __components[i] = component;
+        __validation[i] = 1;
+        ++initialized_patterns;
+    }
+
+    if (initialized_patterns < 1) {
+        UE_LOG(LogTemp, Warning, TEXT("Score layer: no valid pattern cue."));
+        return false;
+    }
+    return true;
+}
+
+void UScoreLayer::Release() {
+
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (__components[i] != nullptr) {
+            __components[i]->Stop();
+            __components[i]->DestroyComponent();
+            __components[i] = nullptr;
+        }
+        __validation[i] = 0;
+    }
+    __playing = false;
+}
+
+void UScoreLayer::Play(float transport_position) {
+
+    float position = (__loop_length > 0.0f) ? FMath::Fmod(transport_position, __loop_length) : transport_position;
+
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (!__playing)
+            __applied_gains[i] = 0.0f;
+        if (__validation[i] == 1) {
+            __components[i]->Play(position);
+            __components[i]->AdjustVolume(0.0f, __applied_gains[i]);
+        }
+    }
+    __playing = true;
+}
+
+void UScoreLayer::Stop(float fade) {
+
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (__validation[i] == 1) {
+            if (fade > 0.0f)
+                __components[i]->FadeOut(fade, 0.0f);
+            else
+                __components[i]->Stop();
+        }
+        __applied_gains[i] = 0.0f;
+    }
+    __playing = false;
+}
+
+void UScoreLayer::QueueChange(bool active, uint8 texture) {
+
+    __has_pending = true;
+    __pending_active = active;
+    __pending_texture = texture;
+}
+
+bool UScoreLayer::ApplyPendingChange() {
+
+    if (!__has_pending)
+        return false;
+
+    __has_pending = false;
+    __texture = __pending_texture;
+    __active = __pending_active;
+    return true;
+}
+
+uint8 UScoreLayer::GetFilteredTexture() {
+
+    if (__dynamic_filter_chain->IsAvailable())
+        return __dynamic_filter_chain->ApplyDynamicFilterChain(__texture);
+    return UStaticFilterChain::ApplyFilterChain(__texture, __filterchain_index);
+}
+
+void UScoreLayer::Decode(uint8 processed_texture, float master_volume, float fade) {
+
+    if (!__playing)
+        return;
+
+    bool b[PTRN_COUNT];
+    UStaticFilterChain::BoolArrayFromByte(processed_texture, b);
+
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        float gain = b[i] ? __volume * master_volume : 0.0f;
+        if (FMath::Abs(gain - __applied_gains[i]) <= GAIN_EPSILON)
+            continue;
+
+        if (__validation[i] == 1)
+            __components[i]->AdjustVolume(fade, gain);
+        __applied_gains[i] = gain;
+    }
+}
+
+UScoreLayer::UScoreLayer() {
+
+    __dynamic_filter_chain = CreateDefaultSubobject<UDynamicFilterChain>(TEXT("layer_dfc"));
+    __score = nullptr;
+    __loop_length = 0.0f;
+    __filterchain_index = 0;
+    __texture = 0;
+    __volume = 1.0f;
+    __active = false;
+    __playing = false;
+    __has_pending = false;
+    __pending_active = false;
+    __pending_texture = 0;
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        __components[i] = nullptr;
+        __validation[i] = 0;
+        __applied_gains[i] = 0.0f;
+    }
+    UE_LOG(LogTemp, Display, TEXT("Score layer created."));
+}
+
+UScoreLayer::~UScoreLayer() {
+    UE_LOG(LogTemp, Display, TEXT("Score layer destroyed."));
+}
@@ -0,0 +1,104 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MixerConstants.h"
+#include "Components/AudioComponent.h"
+#include "AdaptiveScore.h"
+#include "FilterChain.h"
+#include "ScoreLayer.generated.h"
+
+// A secondary score played by an AAdaptiveMixer on top of its own (AAdaptiveMixer::AddScoreLayer).
+//
+// A layer has its own stems, texture and filter chain, but no transport of its own:
+// the mixer starts its stems at the mixer's transport position, so all layers
+// stay phase-locked to the loaded score. Bridges, stingers, intensity, the fade engine
+// and the stem budget belong to the loaded score only.
+
+UCLASS()
+class UScoreLayer : public UObject
+{
+    GENERATED_BODY()
+
+    public:
+    UFUNCTION()
+    bool Initialize(AActor* owner, UAdaptiveScore* score, float layer_volume);
+    // Creates and registers one audio component per valid pattern cue.
+
+    UFUNCTION()
+    void Release(); // stops and destroys the components.
+
+    UFUNCTION()
+    void Play(float transport_position);
+    // (Re)starts every stem at transport_position, wrapped to this score's loop.
+    // Stems keep the gain they had, a layer that was not playing starts silent.
+
+    UFUNCTION()
+    void Stop(float fade);
+
+    UFUNCTION()
+    uint8 GetFilteredTexture();
+
+    void Decode(uint8 processed_texture, float master_volume, float fade);
+    // Only stems whose gain really changed are sent to audio.
+
+    UFUNCTION()
+    UDynamicFilterChain* GetDynamicFilterChain() { return __dynamic_filter_chain; }
+
+    UFUNCTION()
+    UAdaptiveScore* GetScore() { return __score; }
+
+    float GetLoopLength() { return __loop_length; }
+
+    // state, driven by AAdaptiveMixer:
+    uint8 GetTexture() { return __texture; }
+    float GetVolume() { return __volume; }
+    void SetVolume(float volume) { __volume = volume; }
+    bool IsActive() { return __active; }    // wanted to play while the mixer runs
+    bool IsPlaying() { return __playing; }
+
+    // waiting for the next bar:
+    void QueueChange(bool active, uint8 texture);
+    bool ApplyPendingChange();              // false = nothing was pending
+    bool HasPendingChange() { return __has_pending; }
+    bool GetWantedActive() { return __has_pending ? __pending_active : __active; }       // once the
+    uint8 GetWantedTexture() { return __has_pending ? __pending_texture : __texture; }  // change lands
+
+    private:
+    UPROPERTY()     uint8 __texture;
+    UPROPERTY()     float __volume;
+    UPROPERTY()     bool __active;
+    UPROPERTY()     bool __playing;
+
+    UPROPERTY()     bool __has_pending;
+    UPROPERTY()     bool __pending_active;
+    UPROPERTY()     uint8 __pending_texture;
+
+    UPROPERTY()
+    UAdaptiveScore* __score;
+
+    UPROPERTY()
+    UDynamicFilterChain* __dynamic_filter_chain;
+
+    UPROPERTY()
+    UAudioComponent* __components[PTRN_COUNT];
+
+    UPROPERTY()
+    uint8 __validation[PTRN_COUNT];
+
+    UPROPERTY()
+    float __applied_gains[PTRN_COUNT];
+
+    UPROPERTY()
+    float __loop_length;
+
+    UPROPERTY()
+    uint8 __filterchain_index;
+
+    public:
+    UScoreLayer();
+    ~UScoreLayer();
+
+};
@@ -0,0 +1,231 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "StemCache.h"
+#include "AdaptiveMixer.h"
+#include "AdaptiveMixerStats.h"
+#include "HAL/IConsoleManager.h"
+#include "Sound/SoundWave.h"
+
+static TAutoConsoleVariable<int32> CVarStemCacheBudget(
+    TEXT("au.AdaptiveMixer.StemCacheBudgetMB"),
+    0,
+    TEXT("Max size of resident adaptive score cues, in MB. Idle scores are evicted LRU first. 0 = unlimited."),
+    ECVF_Scalability);
+
+DECLARE_MEMORY_STAT(TEXT("Stem cache resident"), STAT_AdaptiveMixerCacheResident, STATGROUP_AdaptiveMixer);
+DECLARE_MEMORY_STAT(TEXT("Stem cache awaiting GC"), STAT_AdaptiveMixerCacheAwaitingGC, STATGROUP_AdaptiveMixer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Stem cache evictions"), STAT_AdaptiveMixerCacheEvictions, STATGROUP_AdaptiveMixer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Stem cache hit rate"), STAT_AdaptiveMixerCacheHitRate, STATGROUP_AdaptiveMixer);
+
+FStemCache& FStemCache::Get() {
+    static FStemCache cache;
+    return cache;
+}
+
+void FStemCache::Load(UAdaptiveScore* score) {
+
+    if (score == nullptr)
+        return;
+
+    __makeResident(__findOrAdd(score));
+    __updateStats(); // evicted from Register on, not before the mixer has read the cues.
+}
+
+void FStemCache::Register(AAdaptiveMixer* mixer, UAdaptiveScore* score) {
+
+    // the mixer's previous score, not its layers:
+    for (FCachedScore& entry : __scores) {
+        entry.mixers.RemoveAll([mixer](const TWeakObjectPtr<AAdaptiveMixer>& x) { return x.Get() == mixer; });
+        entry.players.RemoveAll([mixer](const TWeakObjectPtr<AAdaptiveMixer>& x) { return x.Get() == mixer; });
+    }
+    if (score == nullptr)
+        return;
+
+    FCachedScore& entry = __findOrAdd(score);
+    entry.mixers.Add(mixer);
+    entry.last_used = ++__use_counter;
+    __evict();
+}
+
+void FStemCache::Unregister(AAdaptiveMixer* mixer) {
+
+    for (FCachedScore& entry : __scores) {
+        entry.mixers.RemoveAll([mixer](const TWeakObjectPtr<AAdaptiveMixer>& x) { return x.Get() == mixer; });
+        entry.players.RemoveAll([mixer](const TWeakObjectPtr<AAdaptiveMixer>& x) { return x.Get() == mixer; });
+        entry.layers.RemoveAll([mixer](const TWeakObjectPtr<AAdaptiveMixer>& x) { return x.Get() == mixer; });
+    }
+}
+
+void FStemCache::RegisterLayer(AAdaptiveMixer* mixer, UAdaptiveScore* score) {
+
+    if (score == nullptr)
+        return;
+
+    FCachedScore& entry = __findOrAdd(score);
+    entry.layers.Add(mixer);
+    __makeResident(entry);
+    __evict();
+}
+
+void FStemCache::UnregisterLayer(AAdaptiveMixer* mixer, UAdaptiveScore* score) {
+
+    FCachedScore* entry = __scores.FindByPredicate([score](const FCachedScore& x) { return x.score.Get() == score; });
+    if (entry == nullptr)
+        return;
+
+    int index = entry->layers.IndexOfByPredicate([mixer](const TWeakObjectPtr<AAdaptiveMixer>& x) { return x.Get() == mixer; });
+    if (index != INDEX_NONE)
+        entry->layers.RemoveAt(index);
+    entry->last_used = ++__use_counter;
+    __evict();
+}
+
+void FStemCache::Acquire(AAdaptiveMixer* mixer) {
+
+    FCachedScore* entry = __findByMixer(mixer);
+    if (entry == nullptr)
+        return;
+
+    entry->players.AddUnique(mixer);
+    __makeResident(*entry);
+    __evict();
+}
+
+void FStemCache::Release(AAdaptiveMixer* mixer) {
+
+    FCachedScore* entry = __findByMixer(mixer);
+    if (entry == nullptr)
+        return;
+
+    entry->players.RemoveAll([mixer](const TWeakObjectPtr<AAdaptiveMixer>& x) { return x.Get() == mixer; });
+    entry->last_used = ++__use_counter;
+    __evict();
+}
+
+int64 FStemCache::GetResidentBytes() const {
+    return GetReferencedBytes() + __awaitingCollection();
+}
+
+int64 FStemCache::GetReferencedBytes() const {
+
+    int64 bytes = 0;
+    for (const FCachedScore& entry : __scores) {
+        if (entry.resident)
+            bytes += entry.bytes;
+    }
+    return bytes;
+}
+
+FStemCache::FCachedScore& FStemCache::__findOrAdd(UAdaptiveScore* score) {
+
+    FCachedScore* entry = __scores.FindByPredicate([score](const FCachedScore& x) { return x.score.Get() == score; });
+    if (entry != nullptr)
+        return *entry;
+
+    FCachedScore n;
+    n.score = score;
+    n.last_used = 0;
+    n.bytes = 0;
+    n.resident = false;
+    return __scores[__scores.Add(n)];
+}
+
+FStemCache::FCachedScore* FStemCache::__findByMixer(const AAdaptiveMixer* mixer) {
+
+    return __scores.FindByPredicate([mixer](const FCachedScore& x) {
+        return x.mixers.ContainsByPredicate([mixer](const TWeakObjectPtr<AAdaptiveMixer>& m) { return m.Get() == mixer; });
+    });
+}
+
+void FStemCache::__makeResident(FCachedScore& entry) {
+
+    entry.last_used = ++__use_counter;
+
+    if (entry.resident) {
+        ++__hits;
+        return;
+    }
+
+    // first time seen or evicted since: either way the cues had to be loaded.
+    ++__misses;
+    UAdaptiveScore* score = entry.score.Get();
+    if (!score->AreCuesResident()) {
+        score->ReacquireCues();
+        UE_LOG(AdaptiveMixerLog, Display, TEXT("Stem cache: %s reloaded."), *score->GetName());
+    }
+    entry.bytes = score->GetResidentBytes();
+    entry.resident = true;
+}
+
+void FStemCache::__evict() {
+
+    __scores.RemoveAll([](const FCachedScore& x) { return !x.score.IsValid(); });
+
+    int64 budget = int64(CVarStemCacheBudget.GetValueOnGameThread()) * 1024 * 1024;
+    int64 referenced = GetReferencedBytes();
+
+    while ((budget > 0) && (referenced > budget)) {
+        FCachedScore* victim = nullptr;
+        for (FCachedScore& entry : __scores) {
+            entry.players.RemoveAll([](const TWeakObjectPtr<AAdaptiveMixer>& x) { return !x.IsValid(); });
+            entry.layers.RemoveAll([](const TWeakObjectPtr<AAdaptiveMixer>& x) { return !x.IsValid(); });
+            bool idle = entry.resident && (entry.players.Num() == 0) && (entry.layers.Num() == 0) &&
+                entry.score->CanReleaseCues();
+            if (idle && ((victim == nullptr) || (entry.last_used < victim->last_used)))
+                victim = &entry;
+        }
+        if (victim == nullptr) {
+            UE_LOG(AdaptiveMixerLog, Verbose, TEXT("Stem cache: over budget, nothing idle to evict."));
+            break;
+        }
+
+        // mixers first, so the cues are really unreferenced once the score lets them go:
+        for (const TWeakObjectPtr<AAdaptiveMixer>& mixer : victim->mixers) {
+            if (mixer.IsValid())
+                mixer->OnScoreCuesEvicted();
+        }
+        for (USoundWave* wave : victim->score->GetResidentWaves()) {
+            __released.Add({ wave, wave->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal) });
+        }
+        victim->score->ReleaseCues();
+        victim->resident = false;
+        referenced -= victim->bytes;
+        ++__evictions;
+        UE_LOG(AdaptiveMixerLog, Display, TEXT("Stem cache: %s evicted (%lld bytes, freed by the next GC)."),
+            *victim->score->GetName(), victim->bytes);
+    }
+
+    __updateStats();
+}
+
+int64 FStemCache::__awaitingCollection() const {
+
+    int64 bytes = 0;
+    for (const FReleasedWave& released : __released) {
+        if (released.wave.IsValid())
+            bytes += released.bytes;
+    }
+    return bytes;
+}
+
+void FStemCache::__updateStats() {
+
+    // collected waves are gone for good, reloaded ones are counted by their score again:
+    if (__released.Num() > 0) {
+        TSet<USoundWave*> referenced;
+        for (const FCachedScore& entry : __scores) {
+            if (entry.resident)
+                referenced.Append(entry.score->GetResidentWaves());
+        }
+        __released.RemoveAll([&referenced](const FReleasedWave& x) {
+            return !x.wave.IsValid() || referenced.Contains(x.wave.Get());
+        });
+    }
+
+    uint64 lookups = __hits + __misses;
+    SET_MEMORY_STAT(STAT_AdaptiveMixerCacheResident, GetResidentBytes());
+    SET_MEMORY_STAT(STAT_AdaptiveMixerCacheAwaitingGC, __awaitingCollection());
+    SET_DWORD_STAT(STAT_AdaptiveMixerCacheEvictions, __evictions);
+    SET_FLOAT_STAT(STAT_AdaptiveMixerCacheHitRate, lookups > 0 ? float(__hits) / lookups : 1.0f);
+}
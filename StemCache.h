@@ -0,0 +1,90 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+class AAdaptiveMixer;
+class UAdaptiveScore;
+class USoundWave;
+
+// Keeps the cues of loaded scores within a memory budget, across all mixers.
+//
+// The budget comes from au.AdaptiveMixer.StemCacheBudgetMB (0 = unlimited). A score is
+// in use while a mixer plays it (Run .. Stop) or has it as a score layer. When the cues
+// all known scores reference exceed the budget, scores nobody uses are evicted, least
+// recently used first: the score drops its hard cue references (keeping their asset
+// paths) and so do the mixers that have it loaded. The cues are loaded again when a
+// mixer plays the score. Only cues that are assets can be evicted, cues created at
+// runtime stay resident.
+//
+// Evicting only drops references, the waves stay in memory until garbage collection
+// (or for good, if something else holds them). They are reported as "awaiting GC" until
+// then, and still count as resident; the budget is checked against the referenced part.
+//
+// "stat AdaptiveMixer" shows the hit rate, the eviction count and the resident size.
+
+class FStemCache
+{
+    public:
+
+    static FStemCache& Get();
+
+    void Load(UAdaptiveScore* score);
+    // Makes the score's cues resident before a mixer reads them, counted as a hit or a
+    // miss (the first load of a score is a miss). Doesn't tie the score to a mixer.
+
+    void Register(AAdaptiveMixer* mixer, UAdaptiveScore* score);
+    // The mixer loaded score (InitializeMixer succeeded).
+
+    void Unregister(AAdaptiveMixer* mixer); // its loaded score and its layers.
+
+    void RegisterLayer(AAdaptiveMixer* mixer, UAdaptiveScore* score);
+    void UnregisterLayer(AAdaptiveMixer* mixer, UAdaptiveScore* score);
+    // A score layer holds its cues on components of its own, it's never evicted.
+
+    void Acquire(AAdaptiveMixer* mixer);
+    // The mixer starts playing its score. Reloads the cues if they were evicted, mixers
+    // holding the score are told through AAdaptiveMixer::OnScoreCuesEvicted beforehand.
+
+    void Release(AAdaptiveMixer* mixer);
+    // The mixer stopped; its score may be evicted from now on.
+
+    int64 GetResidentBytes() const;     // referenced + awaiting GC
+    int64 GetReferencedBytes() const;   // what the budget is checked against
+
+    private:
+
+    struct FCachedScore
+    {
+        TWeakObjectPtr<UAdaptiveScore> score;
+        TArray<TWeakObjectPtr<AAdaptiveMixer>> mixers;   // have it loaded
+        TArray<TWeakObjectPtr<AAdaptiveMixer>> players;  // are playing it
+        TArray<TWeakObjectPtr<AAdaptiveMixer>> layers;   // have it as a score layer, once per layer
+        uint64 last_used;
+        int64 bytes;
+        bool resident;
+    };
+
+    struct FReleasedWave
+    {
+        TWeakObjectPtr<USoundWave> wave;
+        int64 bytes;
+    };
+
+    FCachedScore& __findOrAdd(UAdaptiveScore* score);
+    FCachedScore* __findByMixer(const AAdaptiveMixer* mixer);
+    void __makeResident(FCachedScore& entry);
+    void __evict();
+    int64 __awaitingCollection() const;
+    void __updateStats();
+
+    TArray<FCachedScore> __scores;
+    TArray<FReleasedWave> __released;   // evicted, not collected yet
+    uint64 __use_counter = 0;
+    uint64 __hits = 0;
+    uint64 __misses = 0;
+    uint32 __evictions = 0;
+};
@@ -0,0 +1,241 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "StemContainer.h"
+#include "AdaptiveMixer.h"
+#include "Misc/FileHelper.h"
+#include "Sound/SoundNodeWavePlayer.h"
+#include "Audio.h"
+
+static_assert(sizeof(FStemContainerHeader) == 40, "Container header layout changed.");
+static_assert(sizeof(FStemContainerChunk) == 16, "Container chunk layout changed.");
+
+TSharedPtr<FStemContainerReader, ESPMode::ThreadSafe> FStemContainerReader::Open(const FString& path) {
+
+    TSharedPtr<FStemContainerReader, ESPMode::ThreadSafe> reader = MakeShared<FStemContainerReader, ESPMode::ThreadSafe>();
+    reader->__file.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*path));
+    if (!reader->__file.IsValid())
+        return nullptr;
+
+    int64 size = reader->__file->GetFileSize();
+    if (size < int64(sizeof(FStemContainerHeader)))
+        return nullptr;
+
+    reader->__region.Reset(reader->__file->MapRegion(0, size));
+    if (!reader->__region.IsValid())
+        return nullptr;
+
+    reader->__base = reader->__region->GetMappedPtr();
+    const FStemContainerHeader* h = reinterpret_cast<const FStemContainerHeader*>(reader->__base);
+    if ((h->magic != STEM_CONTAINER_MAGIC) || (h->version != STEM_CONTAINER_VERSION) ||
+        (h->stem_count == 0) || (h->stem_count > STEM_CONTAINER_MAX_STEMS) ||
+        (h->sample_rate == 0) || (h->num_channels == 0) || (h->frames_per_chunk == 0) ||
+        (h->chunk_count == 0) || (h->total_frames == 0) ||
+        (uint64(h->total_frames) > uint64(h->chunk_count) * h->frames_per_chunk) ||
+        (h->index_offset + uint64(h->chunk_count) * sizeof(FStemContainerChunk) > uint64(size)))
+        return nullptr;
+
+    // every chunk must be inside the file, the render thread doesn't check again:
+    const FStemContainerChunk* index = reinterpret_cast<const FStemContainerChunk*>(reader->__base + h->index_offset);
+    uint64 chunk_bytes = uint64(h->stem_count) * h->frames_per_chunk * h->num_channels * sizeof(int16);
+    for (uint32 c = 0; c < h->chunk_count; ++c) {
+        if ((index[c].offset + chunk_bytes > uint64(size)) || (index[c].frames > h->frames_per_chunk))
+            return nullptr;
+    }
+
+    reader->__header = h;
+    reader->__index = index;
+    reader->PreloadChunk(0);
+    return reader;
+}
+
+const int16* FStemContainerReader::GetStemFrames(uint32 stem, uint32 frame, uint32& frames_available) const {
+
+    const uint32 frames_per_chunk = __header->frames_per_chunk;
+    const FStemContainerChunk& chunk = __index[frame / frames_per_chunk];
+    const uint32 within = frame % frames_per_chunk;
+    frames_available = chunk.frames > within ? chunk.frames - within : 0;
+
+    const uint64 stem_bytes = uint64(frames_per_chunk) * __header->num_channels * sizeof(int16);
+    const int16* stem_start = reinterpret_cast<const int16*>(__base + chunk.offset + stem * stem_bytes);
+    return stem_start + within * __header->num_channels;
+}
+
+void FStemContainerReader::PreloadChunk(uint32 frame) const {
+
+    const FStemContainerChunk& chunk = __index[(frame / __header->frames_per_chunk) % __header->chunk_count];
+    const uint64 chunk_bytes = uint64(__header->stem_count) * __header->frames_per_chunk * __header->num_channels * sizeof(int16);
+    __region->PreloadHint(int64(chunk.offset), int64(chunk_bytes));
+}
+
+
+void UStemContainerWave::Initialize(TSharedPtr<FStemContainerReader, ESPMode::ThreadSafe> reader, uint32 stem) {
+
+    __reader = reader;
+    __stem = stem;
+    __frame.Set(0);
+    NumChannels = reader->GetNumChannels();
+    SetSampleRate(reader->GetSampleRate());
+    Duration = INDEFINITELY_LOOPING_DURATION;
+    bLooping = true;
+    SoundGroup = SOUNDGROUP_Music;
+}
+
+void UStemContainerWave::SeekTo(float seconds) {
+
+    if (!__reader.IsValid())
+        return;
+
+    uint32 frame = uint32(FMath::Max(seconds, 0.0f) * __reader->GetSampleRate()) % __reader->GetTotalFrames();
+    __frame.Set(int32(frame));
+    __reader->PreloadChunk(frame);
+}
+
+int32 UStemContainerWave::OnGeneratePCMAudio(TArray<uint8>& OutAudio, int32 NumSamples) {
+
+    const uint32 channels = __reader->GetNumChannels();
+    const uint32 total_frames = __reader->GetTotalFrames();
+    const uint32 frames_per_chunk = __reader->GetFramesPerChunk();
+
+    OutAudio.SetNumZeroed(NumSamples * sizeof(int16));
+    int16* out = reinterpret_cast<int16*>(OutAudio.GetData());
+    uint32 frames_needed = uint32(NumSamples) / channels;
+    uint32 frame = uint32(__frame.GetValue()) % total_frames;
+
+    while (frames_needed > 0) {
+        uint32 available = 0;
+        const int16* src = __reader->GetStemFrames(__stem, frame, available);
+        uint32 n = FMath::Min3(available, frames_needed, total_frames - frame);
+        if (n == 0)
+            break;
+
+        FMemory::Memcpy(out, src, n * channels * sizeof(int16));
+        out += n * channels;
+        frames_needed -= n;
+
+        uint32 next = (frame + n) % total_frames;
+        if (next / frames_per_chunk != frame / frames_per_chunk)
+            __reader->PreloadChunk(next + frames_per_chunk); // one chunk ahead
+        frame = next;
+    }
+
+    __frame.Set(int32(frame));
+    return NumSamples;
+}
+
+
+#if WITH_EDITOR
+static bool ReadStemPCM(USoundCue* cue, TArray<int16>& pcm, uint32& sample_rate, uint32& channels) {
+
+    TArray<USoundNodeWavePlayer*> players;
+    cue->RecursiveFindNode<USoundNodeWavePlayer>(cue->FirstNode, players);
+    USoundWave* wave = players.Num() > 0 ? players[0]->GetSoundWave() : nullptr;
+    if (wave == nullptr)
+        return false;
+
+    const uint8* raw = static_cast<const uint8*>(wave->RawData.LockReadOnly());
+    FWaveModInfo info;
+    bool ok = (raw != nullptr) && info.ReadWaveInfo(raw, wave->RawData.GetBulkDataSize()) && (*info.pBitsPerSample == 16);
+    if (ok) {
+        sample_rate = *info.pSamplesPerSec;
+        channels = *info.pChannels;
+        pcm.SetNumUninitialized(info.SampleDataSize / sizeof(int16));
+        FMemory::Memcpy(pcm.GetData(), info.SampleDataStart, pcm.Num() * sizeof(int16));
+    }
+    wave->RawData.Unlock();
+    return ok;
+}
+#endif
+
+bool UStemContainerLibrary::PackStemContainer(UAdaptiveScore* score, FString file_path, int frames_per_chunk) {
+
+#if WITH_EDITOR
+    if ((score == nullptr) || (frames_per_chunk <= 0))
+        return false;
+
+    TArray<USoundCue*> cues = score->GetPatternCues();
+    if ((cues.Num() == 0) || (cues.Num() > int(STEM_CONTAINER_MAX_STEMS))) {
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Stem container: a score needs 1 to %d patterns."), STEM_CONTAINER_MAX_STEMS);
+        return false;
+    }
+
+    TArray<TArray<int16>> stems;
+    stems.SetNum(cues.Num());
+    uint32 present_mask = 0;
+    uint32 sample_rate = 0;
+    uint32 channels = 0;
+    uint32 total_frames = 0;
+
+    for (int s = 0; s < cues.Num(); ++s) {
+        if (cues[s] == nullptr)
+            continue;
+
+        uint32 stem_rate = 0;
+        uint32 stem_channels = 0;
+        if (!ReadStemPCM(cues[s], stems[s], stem_rate, stem_channels)) {
+            UE_LOG(AdaptiveMixerLog, Warning, TEXT("Stem container: can't read 16 bit PCM of %s."), *cues[s]->GetName());
+            return false;
+        }
+        if ((present_mask != 0) && ((stem_rate != sample_rate) || (stem_channels != channels))) {
+            UE_LOG(AdaptiveMixerLog, Warning, TEXT("Stem container: %s differs in sample rate or channels."), *cues[s]->GetName());
+            return false;
+        }
+        sample_rate = stem_rate;
+        channels = stem_channels;
+        total_frames = FMath::Max(total_frames, uint32(stems[s].Num()) / channels);
+        present_mask |= 1u << s;
+    }
+
+    if (present_mask == 0)
+        return false;
+
+    FStemContainerHeader header;
+    header.magic = STEM_CONTAINER_MAGIC;
+    header.version = STEM_CONTAINER_VERSION;
+    header.stem_count = cues.Num();
+    header.present_mask = present_mask;
+    header.sample_rate = sample_rate;
+    header.num_channels = channels;
+    header.frames_per_chunk = frames_per_chunk;
+    header.chunk_count = FMath::DivideAndRoundUp(total_frames, uint32(frames_per_chunk));
+    header.total_frames = total_frames;
+    header.index_offset = sizeof(FStemContainerHeader);
+
+    const uint64 stem_bytes = uint64(frames_per_chunk) * channels * sizeof(int16);
+    const uint64 chunk_bytes = Align(stem_bytes * header.stem_count, uint64(STEM_CONTAINER_ALIGNMENT));
+    const uint64 data_offset = Align(uint64(header.index_offset) + header.chunk_count * sizeof(FStemContainerChunk),
+        uint64(STEM_CONTAINER_ALIGNMENT));
+
+    TArray<uint8> bytes;
+    bytes.SetNumZeroed(data_offset + chunk_bytes * header.chunk_count);
+    FMemory::Memcpy(bytes.GetData(), &header, sizeof(header));
+
+    FStemContainerChunk* index = reinterpret_cast<FStemContainerChunk*>(bytes.GetData() + header.index_offset);
+    for (uint32 c = 0; c < header.chunk_count; ++c) {
+        uint32 first_frame = c * frames_per_chunk;
+        index[c].offset = data_offset + c * chunk_bytes;
+        index[c].frames = FMath::Min(uint32(frames_per_chunk), total_frames - first_frame);
+        index[c].reserved = 0;
+
+        for (uint32 s = 0; s < header.stem_count; ++s) {
+            int32 stem_frames = stems[s].Num() / channels;
+            int32 copy_frames = FMath::Clamp(stem_frames - int32(first_frame), 0, int32(index[c].frames));
+            if (copy_frames > 0) {
+                FMemory::Memcpy(bytes.GetData() + index[c].offset + s * stem_bytes,
+                    stems[s].GetData() + first_frame * channels, copy_frames * channels * sizeof(int16));
+            }
+        }
+    }
+
+    if (!FFileHelper::SaveArrayToFile(bytes, *file_path)) {
+        UE_LOG(AdaptiveMixerLog, Warning, TEXT("Stem container: can't write %s."), *file_path);
+        return false;
+    }
+    UE_LOG(AdaptiveMixerLog, Display, TEXT("Stem container: %d stems, %u chunks, %.2f s -> %s"),
+        header.stem_count, header.chunk_count, float(total_frames) / sample_rate, *file_path);
+    return true;
+#else
+    UE_LOG(AdaptiveMixerLog, Warning, TEXT("Stem containers can only be packed in the editor."));
+    return false;
+#endif
+}
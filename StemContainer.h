@@ -0,0 +1,119 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Async/MappedFileHandle.h"
+#include "Sound/SoundWaveProcedural.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "StemContainer.generated.h"
+
+class UAdaptiveScore;
+
+// All pattern stems of a score packed into one file (UStemContainerLibrary::PackStemContainer),
+// attached with UAdaptiveScore::SetStemContainer.
+//
+// Layout, little endian:
+//
+//     header          FStemContainerHeader
+//     chunk index     chunk_count x FStemContainerChunk
+//     chunks          each one starts on a STEM_CONTAINER_ALIGNMENT boundary and holds
+//                     frames_per_chunk frames of every stem, stem after stem:
+//                     [stem 0: frames x channels int16][stem 1: ...]...
+//
+// A chunk covers the same stretch of music for all stems, so a score plays from one
+// mapped file read front to back instead of one stream per cue. Stems are rendered
+// straight out of the mapping, nothing is decoded or copied on the way except into
+// the mixer's own buffer.
+
+constexpr uint32 STEM_CONTAINER_MAGIC = 0x43534D41; // "AMSC"
+constexpr uint32 STEM_CONTAINER_VERSION = 1;
+constexpr uint32 STEM_CONTAINER_ALIGNMENT = 4096;   // page size on every target platform
+constexpr uint32 STEM_CONTAINER_MAX_STEMS = 32;
+
+struct FStemContainerHeader
+{
+    uint32 magic;
+    uint32 version;
+    uint32 stem_count;
+    uint32 present_mask;        // stems that had a cue; the others are silence
+    uint32 sample_rate;
+    uint32 num_channels;        // per stem
+    uint32 frames_per_chunk;
+    uint32 chunk_count;
+    uint32 total_frames;        // per stem, the loop length
+    uint32 index_offset;
+};
+
+struct FStemContainerChunk
+{
+    uint64 offset;
+    uint32 frames;
+    uint32 reserved;
+};
+
+class FStemContainerReader
+{
+    public:
+
+    static TSharedPtr<FStemContainerReader, ESPMode::ThreadSafe> Open(const FString& path);
+
+    uint32 GetStemCount() const { return __header->stem_count; }
+    bool IsStemPresent(uint32 stem) const { return (__header->present_mask & (1u << stem)) != 0; }
+    uint32 GetSampleRate() const { return __header->sample_rate; }
+    uint32 GetNumChannels() const { return __header->num_channels; }
+    uint32 GetTotalFrames() const { return __header->total_frames; }
+    uint32 GetFramesPerChunk() const { return __header->frames_per_chunk; }
+    float GetDuration() const { return float(__header->total_frames) / __header->sample_rate; }
+
+    const int16* GetStemFrames(uint32 stem, uint32 frame, uint32& frames_available) const;
+    // Points into the mapping. frames_available: up to the end of the chunk.
+
+    void PreloadChunk(uint32 frame) const; // asks the OS to page in the chunk holding frame.
+
+    private:
+
+    TUniquePtr<IMappedFileHandle> __file;
+    TUniquePtr<IMappedFileRegion> __region;
+    const uint8* __base = nullptr;
+    const FStemContainerHeader* __header = nullptr;
+    const FStemContainerChunk* __index = nullptr;
+};
+
+
+UCLASS()
+class UStemContainerWave : public USoundWaveProcedural
+{
+    GENERATED_BODY()
+
+    public:
+
+    void Initialize(TSharedPtr<FStemContainerReader, ESPMode::ThreadSafe> reader, uint32 stem);
+
+    void SeekTo(float seconds); // procedural sounds ignore Play(start_time), seek here before Play.
+
+    virtual int32 OnGeneratePCMAudio(TArray<uint8>& OutAudio, int32 NumSamples) override;
+    // Audio render thread. Loops over the container.
+
+    private:
+
+    TSharedPtr<FStemContainerReader, ESPMode::ThreadSafe> __reader;
+    uint32 __stem = 0;
+    FThreadSafeCounter __frame;
+};
+
+
+UCLASS()
+class UStemContainerLibrary : public UBlueprintFunctionLibrary
+{
+    GENERATED_BODY()
+
+    public:
+
+    UFUNCTION(BlueprintCallable, Category = "AdaptiveMixer", meta = (DevelopmentOnly))
+    static bool PackStemContainer(UAdaptiveScore* score, FString file_path, int frames_per_chunk = 32768);
+    // Editor only. Reads the first wave of every pattern cue (16 bit PCM, all with the same
+    // sample rate and channel count) and writes the container. Shorter stems are padded with silence.
+};
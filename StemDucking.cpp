@@ -0,0 +1,40 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "StemDucking.h"
+
+FStemDuckingListener::FStemDuckingListener(TSharedPtr<FStemFadeEngine, ESPMode::ThreadSafe> engine,
+    float attack, float release, float depth) {
+
+    __engine = engine;
+    __envelope = 0.0f;
+    Configure(attack, release, depth);
+}
+
+void FStemDuckingListener::Configure(float attack, float release, float depth) {
+
+    __attack = FMath::Max(attack, 0.001f);
+    __release = FMath::Max(release, 0.001f);
+    __depth = FMath::Clamp(depth, 0.0f, 1.0f);
+}
+
+void FStemDuckingListener::OnNewSubmixBuffer(const USoundSubmix* OwningSubmix, float* AudioData, int32 NumSamples,
+    int32 NumChannels, const int32 SampleRate, double AudioClock) {
+
+    TSharedPtr<FStemFadeEngine, ESPMode::ThreadSafe> engine = __engine.Pin();
+    if (!engine.IsValid() || (NumChannels <= 0) || (SampleRate <= 0))
+        return;
+
+    float peak = 0.0f;
+    for (int32 i = 0; i < NumSamples; ++i) {
+        peak = FMath::Max(peak, FMath::Abs(AudioData[i]));
+    }
+
+    // one-pole follower, stepped once per buffer:
+    float block_seconds = float(NumSamples / NumChannels) / SampleRate;
+    float time = (peak > __envelope) ? __attack : __release;
+    float coefficient = FMath::Exp(-block_seconds / time);
+    __envelope = peak + (__envelope - peak) * coefficient;
+
+    engine->SetDuckGain(1.0f - __depth * FMath::Min(__envelope, 1.0f));
+}
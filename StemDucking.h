@@ -0,0 +1,37 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AudioDevice.h"
+#include "Sound/SoundSubmix.h"
+#include "StemFadeEngine.h"
+
+// Sidechain ducking of the pattern stems.
+//
+// The stinger and bridge components send to the score's sidechain submix
+// (UAdaptiveScore::SetDucking). This listener follows the envelope of that submix on the
+// audio render thread and writes the duck gain straight into the mixer's FStemFadeEngine.
+// Give the sidechain submix an output volume of 0 if it should only be listened to.
+
+class FStemDuckingListener : public ISubmixBufferListener
+{
+    public:
+
+    FStemDuckingListener(TSharedPtr<FStemFadeEngine, ESPMode::ThreadSafe> engine,
+        float attack, float release, float depth);
+
+    void Configure(float attack, float release, float depth);
+
+    virtual void OnNewSubmixBuffer(const USoundSubmix* OwningSubmix, float* AudioData, int32 NumSamples,
+        int32 NumChannels, const int32 SampleRate, double AudioClock) override;
+
+    private:
+
+    TWeakPtr<FStemFadeEngine, ESPMode::ThreadSafe> __engine;
+    float __attack;
+    float __release;
+    float __depth;
+    float __envelope;
+};
@@ -0,0 +1,254 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "StemFadeEngine.h"
+#include "ControlLatency.h"
+#include "Misc/ScopeLock.h"
+
+static_assert(PTRN_COUNT % 4 == 0, "__advance() processes stems in groups of 4.");
+
+constexpr float INSTANT_FADE_RATE = 1.0e6f;
+
+struct FStemFadeRegistration
+{
+    TWeakPtr<FStemFadeEngine, ESPMode::ThreadSafe> engine;
+    uint8 stem;
+};
+
+static FCriticalSection& StemFadeRegistryLock() {
+    static FCriticalSection lock;
+    return lock;
+}
+
+static TMap<uint64, FStemFadeRegistration>& StemFadeRegistry() {
+    static TMap<uint64, FStemFadeRegistration> registry;
+    return registry;
+}
+
+FStemFadeEngine::FStemFadeEngine() {
+
+    __curve = EStemFadeCurve::EqualPower;
+    __last_clock = -1.0;
+    __duck_target = 1.0f;
+    __duck_current = 1.0f;
+    __duck_previous = 1.0f;
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        __current[i] = 0.0f;
+        __previous[i] = 0.0f;
+        __start[i] = 0.0f;
+        __target[i] = 0.0f;
+        __progress[i] = 1.0f;
+        __rate[i] = 0.0f;
+        __w_linear[i] = 1.0f;
+        __w_scurve[i] = 0.0f;
+        __w_sin[i] = 0.0f;
+        __w_cos[i] = 0.0f;
+    }
+}
+
+bool FStemFadeEngine::ParseCurveName(const FString& name, EStemFadeCurve& curve) {
+
+    FString n = name.ToLower();
+    if (n == TEXT("linear"))
+        curve = EStemFadeCurve::Linear;
+    else if (n == TEXT("equal_power"))
+        curve = EStemFadeCurve::EqualPower;
+    else if (n == TEXT("s_curve"))
+        curve = EStemFadeCurve::SCurve;
+    else if (n == TEXT("custom"))
+        curve = EStemFadeCurve::Custom;
+    else
+        return false;
+    return true;
+}
+
+void FStemFadeEngine::SetCurve(EStemFadeCurve curve, const UCurveFloat* custom_curve) {
+
+    __curve = curve;
+    __custom_table.Reset();
+
+    if ((curve == EStemFadeCurve::Custom) && (custom_curve != nullptr)) {
+        TSharedPtr<TArray<float>, ESPMode::ThreadSafe> table = MakeShared<TArray<float>, ESPMode::ThreadSafe>();
+        table->SetNumUninitialized(FADE_CUSTOM_CURVE_SIZE);
+        for (int i = 0; i < FADE_CUSTOM_CURVE_SIZE; ++i) {
+            float t = float(i) / float(FADE_CUSTOM_CURVE_SIZE - 1);
+            (*table)[i] = FMath::Clamp(custom_curve->GetFloatValue(t), 0.0f, 1.0f);
+        }
+        __custom_table = table;
+    }
+    else if (curve == EStemFadeCurve::Custom) {
+        __curve = EStemFadeCurve::Linear;
+    }
+}
+
+void FStemFadeEngine::SetTarget(uint8 stem, float target, float duration, uint32 latency_token) {
+
+    if (stem >= PTRN_COUNT)
+        return;
+
+    FStemFadeCommand c;
+    c.stem = stem;
+    c.target = target;
+    c.duration = duration;
+    c.curve = __curve;
+    c.custom_table = __custom_table;
+    c.latency_token = latency_token;
+    __commands.Enqueue(c);
+}
+
+void FStemFadeEngine::Register(uint64 audio_component_id, TSharedPtr<FStemFadeEngine, ESPMode::ThreadSafe> engine,
+    uint8 stem) {
+
+    FScopeLock lock(&StemFadeRegistryLock());
+    FStemFadeRegistration r;
+    r.engine = engine;
+    r.stem = stem;
+    StemFadeRegistry().Add(audio_component_id, r);
+}
+
+void FStemFadeEngine::Unregister(uint64 audio_component_id) {
+
+    FScopeLock lock(&StemFadeRegistryLock());
+    StemFadeRegistry().Remove(audio_component_id);
+}
+
+TSharedPtr<FStemFadeEngine, ESPMode::ThreadSafe> FStemFadeEngine::Find(uint64 audio_component_id, uint8& stem) {
+
+    FScopeLock lock(&StemFadeRegistryLock());
+    const FStemFadeRegistration* r = StemFadeRegistry().Find(audio_component_id);
+    if (r == nullptr)
+        return nullptr;
+
+    stem = r->stem;
+    return r->engine.Pin();
+}
+
+void FStemFadeEngine::GetBlockGains(uint8 stem, double audio_clock, float block_seconds, float& from, float& to) {
+
+    FScopeLock lock(&__render_lock);
+    if (audio_clock != __last_clock) {
+        __last_clock = audio_clock;
+        __drainCommands();
+        __advance(block_seconds);
+        __duck_previous = __duck_current;
+        __duck_current = __duck_target;
+    }
+    from = __previous[stem] * __duck_previous;
+    to = __current[stem] * __duck_current;
+}
+
+void FStemFadeEngine::SetDuckGain(float gain) {
+
+    FScopeLock lock(&__render_lock);
+    __duck_target = gain;
+}
+
+void FStemFadeEngine::__drainCommands() {
+
+    FStemFadeCommand c;
+    while (__commands.Dequeue(c)) {
+        uint8 s = c.stem;
+        __start[s] = __current[s];
+        __target[s] = c.target;
+        __progress[s] = 0.0f;
+        __rate[s] = c.duration > 0.0f ? 1.0f / c.duration : INSTANT_FADE_RATE;
+        __w_linear[s] = (c.curve == EStemFadeCurve::Linear) ? 1.0f : 0.0f;
+        __w_scurve[s] = (c.curve == EStemFadeCurve::SCurve) ? 1.0f : 0.0f;
+        __w_sin[s] = ((c.curve == EStemFadeCurve::EqualPower) && (c.target >= __start[s])) ? 1.0f : 0.0f;
+        __w_cos[s] = ((c.curve == EStemFadeCurve::EqualPower) && (c.target < __start[s])) ? 1.0f : 0.0f;
+        __stem_table[s] = (c.curve == EStemFadeCurve::Custom) ? c.custom_table : nullptr;
+        FControlLatencyTracker::Get().Complete(c.latency_token); // this buffer starts the fade.
+    }
+}
+
+void FStemFadeEngine::__advance(float block_seconds) {
+
+    // gain = start + (target - start) * shape(progress), where shape is a weighted sum of
+    // all built-in curves with exactly one weight set, so every stem goes through the same ops.
+    const VectorRegister zero = VectorZero();
+    const VectorRegister one = VectorOne();
+    const VectorRegister two = VectorSetFloat1(2.0f);
+    const VectorRegister three = VectorSetFloat1(3.0f);
+    const VectorRegister half_pi = VectorSetFloat1(HALF_PI);
+    const VectorRegister dt = VectorSetFloat1(block_seconds);
+
+    for (int i = 0; i < PTRN_COUNT; i += 4) {
+        VectorStore(VectorLoad(&__current[i]), &__previous[i]);
+
+        VectorRegister p = VectorMultiplyAdd(VectorLoad(&__rate[i]), dt, VectorLoad(&__progress[i]));
+        p = VectorMin(VectorMax(p, zero), one);
+        VectorStore(p, &__progress[i]);
+
+        VectorRegister s_curve = VectorMultiply(VectorMultiply(p, p), VectorSubtract(three, VectorMultiply(two, p)));
+        VectorRegister angle = VectorMultiply(p, half_pi);
+        VectorRegister sin_p;
+        VectorRegister cos_p;
+        VectorSinCos(&sin_p, &cos_p, &angle);
+
+        VectorRegister shape = VectorMultiply(VectorLoad(&__w_linear[i]), p);
+        shape = VectorMultiplyAdd(VectorLoad(&__w_scurve[i]), s_curve, shape);
+        shape = VectorMultiplyAdd(VectorLoad(&__w_sin[i]), sin_p, shape);
+        shape = VectorMultiplyAdd(VectorLoad(&__w_cos[i]), VectorSubtract(one, cos_p), shape);
+
+        VectorRegister start = VectorLoad(&__start[i]);
+        VectorStore(VectorMultiplyAdd(VectorSubtract(VectorLoad(&__target[i]), start), shape, start), &__current[i]);
+    }
+
+    // custom curves are a table lookup, done per stem:
+    for (int i = 0; i < PTRN_COUNT; ++i) {
+        if (!__stem_table[i].IsValid())
+            continue;
+
+        const TArray<float>& table = *__stem_table[i];
+        float position = __progress[i] * (FADE_CUSTOM_CURVE_SIZE - 1);
+        int index = FMath::Min(int(position), FADE_CUSTOM_CURVE_SIZE - 2);
+        float shape = FMath::Lerp(table[index], table[index + 1], position - index);
+        __current[i] = __start[i] + (__target[i] - __start[i]) * shape;
+    }
+}
+
+
+void FStemGainSource::Init(const FSoundEffectSourceInitData& InitData) {
+
+    __audio_component_id = InitData.AudioComponentId;
+    __sample_rate = InitData.SampleRate;
+    __num_channels = FMath::Max(InitData.NumSourceChannels, 1);
+    OnPresetChanged();
+}
+
+void FStemGainSource::OnPresetChanged() {
+
+    GET_EFFECT_SETTINGS(StemGainSource);
+    __unowned_gain = Settings.unowned_gain;
+}
+
+void FStemGainSource::ProcessAudio(const FSoundEffectSourceInputData& InData, float* OutAudioBufferData) {
+
+    const float* in = InData.InputSourceEffectBufferPtr;
+    const int32 num_samples = InData.NumSamples;
+
+    uint8 stem = 0;
+    TSharedPtr<FStemFadeEngine, ESPMode::ThreadSafe> engine = FStemFadeEngine::Find(__audio_component_id, stem);
+    if (!engine.IsValid()) {
+        for (int32 i = 0; i < num_samples; ++i) {
+            OutAudioBufferData[i] = in[i] * __unowned_gain;
+        }
+        return;
+    }
+
+    const int32 num_frames = num_samples / __num_channels;
+    float from = 0.0f;
+    float to = 0.0f;
+    engine->GetBlockGains(stem, InData.AudioClock, float(num_frames) / __sample_rate, from, to);
+
+    // per-sample ramp inside the buffer, no zipper noise:
+    const float step = num_frames > 0 ? (to - from) / num_frames : 0.0f;
+    float gain = from;
+    for (int32 f = 0; f < num_frames; ++f) {
+        gain += step;
+        for (int32 c = 0; c < __num_channels; ++c) {
+            const int32 i = f * __num_channels + c;
+            OutAudioBufferData[i] = in[i] * gain;
+        }
+    }
+}
@@ -0,0 +1,135 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MixerConstants.h"
+#include "Containers/Queue.h"
+#include "Sound/SoundEffectSource.h"
+#include "Curves/CurveFloat.h"
+#include "StemFadeEngine.generated.h"
+
+constexpr int FADE_CUSTOM_CURVE_SIZE = 64;  // custom curves are sampled into a table.
+
+// Fades for all stems of one mixer, advanced on the audio render thread.
+//
+// The game thread only enqueues targets (SetTarget). Once per render buffer the engine
+// drains the queue and moves all stem gains forward in one vectorized pass.
+// Each pattern stem applies its gain through UStemGainSourcePreset, which must be in
+// the source effect chain of the pattern cues. It finds its engine by audio component id.
+
+enum class EStemFadeCurve : uint8
+{
+    Linear,
+    EqualPower,     // sin / cos, keeps the loudness of a crossfade constant
+    SCurve,         // smoothstep
+    Custom          // designer-authored UCurveFloat, 0..1 -> 0..1
+};
+
+struct FStemFadeCommand
+{
+    uint8 stem;
+    float target;
+    float duration;
+    EStemFadeCurve curve;
+    TSharedPtr<TArray<float>, ESPMode::ThreadSafe> custom_table;
+    uint32 latency_token;   // FControlLatencyTracker, completed when drained
+};
+
+class FStemFadeEngine
+{
+    public:
+
+    FStemFadeEngine();
+
+    // G A M E  T H R E A D :
+
+    void SetCurve(EStemFadeCurve curve, const UCurveFloat* custom_curve = nullptr);
+    void SetTarget(uint8 stem, float target, float duration, uint32 latency_token = 0);
+
+    static bool ParseCurveName(const FString& name, EStemFadeCurve& curve);
+    // "linear", "equal_power", "s_curve" or "custom".
+
+    static void Register(uint64 audio_component_id, TSharedPtr<FStemFadeEngine, ESPMode::ThreadSafe> engine, uint8 stem);
+    static void Unregister(uint64 audio_component_id);
+
+    // A U D I O  R E N D E R  T H R E A D :
+
+    static TSharedPtr<FStemFadeEngine, ESPMode::ThreadSafe> Find(uint64 audio_component_id, uint8& stem);
+
+    void GetBlockGains(uint8 stem, double audio_clock, float block_seconds, float& from, float& to);
+    // Gains at the start and at the end of the current buffer; advances all stems
+    // once per buffer (the first stem to ask for a new audio clock does it).
+
+    void SetDuckGain(float gain);
+    // Multiplies every stem; written by FStemDuckingListener once per buffer.
+
+    private:
+
+    void __drainCommands();
+    void __advance(float block_seconds);
+
+    TQueue<FStemFadeCommand, EQueueMode::Mpsc> __commands;
+
+    // game thread side:
+    EStemFadeCurve __curve;
+    TSharedPtr<TArray<float>, ESPMode::ThreadSafe> __custom_table;
+
+    // render thread side, one contiguous array per field:
+    FCriticalSection __render_lock;
+    double __last_clock;
+    float __duck_target;
+    float __duck_current;
+    float __duck_previous;
+    float __current[PTRN_COUNT];
+    float __previous[PTRN_COUNT];
+    float __start[PTRN_COUNT];
+    float __target[PTRN_COUNT];
+    float __progress[PTRN_COUNT];
+    float __rate[PTRN_COUNT];      // 1 / duration
+    float __w_linear[PTRN_COUNT];  // curve selection weights, 0 or 1
+    float __w_scurve[PTRN_COUNT];
+    float __w_sin[PTRN_COUNT];     // equal power, rising
+    float __w_cos[PTRN_COUNT];     // equal power, falling
+    TSharedPtr<TArray<float>, ESPMode::ThreadSafe> __stem_table[PTRN_COUNT];
+};
+
+
+USTRUCT(BlueprintType)
+struct FStemGainSourceSettings
+{
+    GENERATED_USTRUCT_BODY()
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = SourceEffectPreset)
+    float unowned_gain = 1.0f;  // used when the sound is not played by a mixer with the fade engine on.
+};
+
+class FStemGainSource : public FSoundEffectSource
+{
+    public:
+
+    virtual void Init(const FSoundEffectSourceInitData& InitData) override;
+    virtual void OnPresetChanged() override;
+    virtual void ProcessAudio(const FSoundEffectSourceInputData& InData, float* OutAudioBufferData) override;
+
+    private:
+
+    uint64 __audio_component_id = 0;
+    float __sample_rate = 48000.0f;
+    int32 __num_channels = 1;
+    float __unowned_gain = 1.0f;
+};
+
+UCLASS(ClassGroup = AudioSourceEffect, meta = (BlueprintSpawnableComponent))
+class UStemGainSourcePreset : public USoundEffectSourcePreset
+{
+    GENERATED_BODY()
+
+    public:
+
+    EFFECT_PRESET_METHODS(StemGainSource)
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = SourceEffectPreset)
+    FStemGainSourceSettings Settings;
+};
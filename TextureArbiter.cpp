@@ -0,0 +1,108 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "TextureArbiter.h"
+
+void UTextureArbiter::Request(FName requester, uint8 texture, int priority, FString mode, float min_hold) {
+
+    mode = mode.ToLower();
+    if ((mode != TEXT("or")) && (mode != TEXT("and")) && (mode != TEXT("override"))) {
+        UE_LOG(LogTemp, Warning, TEXT("Texture arbiter: unknown mode \"%s\"."), *mode);
+        return;
+    }
+
+    FTextureRequest* r = __requests.FindByPredicate([requester](const FTextureRequest& x) { return x.requester == requester; });
+    if (r == nullptr) {
+        FTextureRequest n;
+        n.requester = requester;
+        n.texture = texture;
+        n.priority = priority;
+        n.mode = mode;
+        n.min_hold = FMath::Max(min_hold, 0.0f);
+        n.active_since = -1.0f; // the hold starts at the next Resolve.
+        __requests.Add(n);
+    }
+    else {
+        r->has_pending = true;
+        r->pending_release = false;
+        r->pending_texture = texture;
+        r->pending_priority = priority;
+        r->pending_mode = mode;
+        r->pending_min_hold = FMath::Max(min_hold, 0.0f);
+    }
+    __dirty = true;
+}
+
+void UTextureArbiter::Release(FName requester) {
+
+    FTextureRequest* r = __requests.FindByPredicate([requester](const FTextureRequest& x) { return x.requester == requester; });
+    if (r == nullptr)
+        return;
+
+    r->has_pending = true;
+    r->pending_release = true;
+    __dirty = true;
+}
+
+void UTextureArbiter::SetBaseTexture(uint8 texture) {
+    __base_texture = texture;
+    __dirty = true;
+}
+
+void UTextureArbiter::Clear() {
+    __requests.Empty();
+    __dirty = true;
+}
+
+uint8 UTextureArbiter::Resolve(float time) {
+
+    // pending changes whose hold has passed:
+    for (int i = __requests.Num() - 1; i >= 0; --i) {
+        FTextureRequest& r = __requests[i];
+        if (r.active_since < 0.0f)
+            r.active_since = time;
+        if (!r.has_pending || (time - r.active_since < r.min_hold))
+            continue;
+
+        if (r.pending_release) {
+            __requests.RemoveAt(i);
+            continue;
+        }
+        r.texture = r.pending_texture;
+        r.priority = r.pending_priority;
+        r.mode = r.pending_mode;
+        r.min_hold = r.pending_min_hold;
+        r.active_since = time;
+        r.has_pending = false;
+    }
+
+    __requests.StableSort([](const FTextureRequest& a, const FTextureRequest& b) { return a.priority < b.priority; });
+
+    uint8 result = __base_texture;
+    for (const FTextureRequest& r : __requests) {
+        if (r.mode == TEXT("or"))
+            result |= r.texture;
+        else if (r.mode == TEXT("and"))
+            result &= r.texture;
+        else if (r.mode == TEXT("override"))
+            result = r.texture;
+    }
+
+    bool waiting = __requests.ContainsByPredicate([](const FTextureRequest& x) { return x.has_pending; });
+    __dirty = waiting;
+    return result;
+}
+
+bool UTextureArbiter::IsDirty() {
+    return __dirty;
+}
+
+UTextureArbiter::UTextureArbiter() {
+    __base_texture = 0;
+    __dirty = false;
+    UE_LOG(LogTemp, Display, TEXT("Texture arbiter created."));
+}
+
+UTextureArbiter::~UTextureArbiter() {
+    UE_LOG(LogTemp, Display, TEXT("Texture arbiter destroyed."));
+}
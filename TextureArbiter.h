@@ -0,0 +1,90 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TextureArbiter.generated.h"
+
+USTRUCT()
+struct FTextureRequest
+{
+    GENERATED_BODY()
+
+    public:
+
+    UPROPERTY()     FName requester;
+
+    // in effect:
+    UPROPERTY()     uint8 texture;
+    UPROPERTY()     int priority;
+    UPROPERTY()     FString mode;
+    UPROPERTY()     float min_hold;
+    UPROPERTY()     float active_since;
+
+    // waiting for min_hold to pass:
+    UPROPERTY()     bool has_pending;
+    UPROPERTY()     bool pending_release;
+    UPROPERTY()     uint8 pending_texture;
+    UPROPERTY()     int pending_priority;
+    UPROPERTY()     FString pending_mode;
+    UPROPERTY()     float pending_min_hold;
+
+    FTextureRequest()
+    {
+        requester = NAME_None;
+        texture = 0;
+        priority = 0;
+        mode = TEXT("or");
+        min_hold = 0.0f;
+        active_since = 0.0f;
+        has_pending = false;
+        pending_release = false;
+        pending_texture = 0;
+        pending_priority = 0;
+        pending_mode = TEXT("or");
+        pending_min_hold = 0.0f;
+    }
+};
+
+
+UCLASS(Blueprintable)
+class UTextureArbiter : public UObject
+{
+    GENERATED_BODY()
+
+    public:
+    UFUNCTION(BlueprintCallable)    void Request(FName requester, uint8 texture, int priority,
+                                    FString mode, float min_hold = 0.0f);
+                                    // "Mode" must be "or", "and" or "override".
+                                    // Requests are blended from the lowest priority up,
+                                    // so a higher "override" wins over everything below.
+                                    // A request stays in effect for at least min_hold seconds;
+                                    // changes and releases coming earlier wait for it.
+    UFUNCTION(BlueprintCallable)    void Release(FName requester);
+
+    UFUNCTION(BlueprintCallable)    void SetBaseTexture(uint8 texture);
+                                    // What requests are blended onto (default 0000 0000).
+    UFUNCTION(BlueprintCallable)    void Clear();
+
+    UFUNCTION()
+    uint8 Resolve(float time);
+
+    UFUNCTION()
+    bool IsDirty(); // something to resolve: a new request, or a change waiting for its hold.
+
+    private:
+    UPROPERTY()
+    TArray<FTextureRequest> __requests;
+
+    UPROPERTY()
+    uint8 __base_texture;
+
+    UPROPERTY()
+    bool __dirty;
+
+    public:
+    UTextureArbiter();
+    ~UTextureArbiter();
+
+};
@@ -0,0 +1,73 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "TextureRules.h"
+#include "MixerConstants.h"
+
+void UTextureRuleSet::AddFloatRule(FName parameter, uint8 track, float on_threshold,
+    float off_threshold, float min_dwell) {
+
+    if (track >= PTRN_COUNT)
+        return;
+
+    FTextureRule r;
+    r.parameter = parameter;
+    r.track = track;
+    r.on_threshold = on_threshold;
+    r.off_threshold = FMath::Min(off_threshold, on_threshold);
+    r.min_dwell = FMath::Max(min_dwell, 0.0f);
+    __rules.Add(r);
+}
+
+void UTextureRuleSet::AddBoolRule(FName parameter, uint8 track, float min_dwell) {
+    AddFloatRule(parameter, track, 0.5f, 0.5f, min_dwell);
+}
+
+void UTextureRuleSet::SetFloatParameter(FName parameter, float value) {
+    __parameters.Add(parameter, value);
+}
+
+void UTextureRuleSet::SetBoolParameter(FName parameter, bool value) {
+    __parameters.Add(parameter, value ? 1.0f : 0.0f);
+}
+
+void UTextureRuleSet::Clear() {
+    __rules.Empty();
+    __parameters.Empty();
+}
+
+uint8 UTextureRuleSet::Evaluate(uint8 current_texture, float time) {
+
+    uint8 result = current_texture;
+    for (int i = 0; i < __rules.Num(); ++i) {
+        FTextureRule& r = __rules[i];
+        const float* value = __parameters.Find(r.parameter);
+        if (value == nullptr)
+            continue;
+
+        bool wanted = r.state ? (*value >= r.off_threshold) : (*value >= r.on_threshold);
+        if ((wanted != r.state) && (time - r.last_change_time >= r.min_dwell)) {
+            r.state = wanted;
+            r.last_change_time = time;
+        }
+
+        uint8 bit = 1 << r.track;
+        result = r.state ? (result | bit) : (result & uint8(~bit));
+    }
+    return result;
+}
+
+bool UTextureRuleSet::IsAvailable() {
+    if (__rules.Num() > 0)
+        return true;
+    else
+        return false;
+}
+
+UTextureRuleSet::UTextureRuleSet() {
+    UE_LOG(LogTemp, Display, TEXT("Texture rule set created."));
+}
+
+UTextureRuleSet::~UTextureRuleSet() {
+    UE_LOG(LogTemp, Display, TEXT("Texture rule set destroyed."));
+}
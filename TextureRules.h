@@ -0,0 +1,72 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TextureRules.generated.h"
+
+USTRUCT()
+struct FTextureRule
+{
+    GENERATED_BODY()
+
+    public:
+
+    UPROPERTY()     FName parameter;
+    UPROPERTY()     uint8 track;
+    UPROPERTY()     float on_threshold;     // bit goes on when value >= on_threshold,
+    UPROPERTY()     float off_threshold;    // and off again when value < off_threshold.
+    UPROPERTY()     float min_dwell;        // seconds the bit must keep its state before it may flip.
+
+    UPROPERTY()     bool state;
+    UPROPERTY()     float last_change_time;
+
+    FTextureRule()
+    {
+        parameter = NAME_None;
+        track = 0;
+        on_threshold = 0.5f;
+        off_threshold = 0.5f;
+        min_dwell = 0.0f;
+        state = false;
+        last_change_time = -BIG_NUMBER;
+    }
+};
+
+
+UCLASS(Blueprintable)
+class UTextureRuleSet : public UObject
+{
+    GENERATED_BODY()
+
+    public:
+    UFUNCTION(BlueprintCallable)    void AddFloatRule(FName parameter, uint8 track, float on_threshold,
+                                    float off_threshold, float min_dwell = 0.0f);
+                                    // off_threshold < on_threshold gives hysteresis.
+    UFUNCTION(BlueprintCallable)    void AddBoolRule(FName parameter, uint8 track, float min_dwell = 0.0f);
+
+    UFUNCTION(BlueprintCallable)    void SetFloatParameter(FName parameter, float value);
+    UFUNCTION(BlueprintCallable)    void SetBoolParameter(FName parameter, bool value);
+
+    UFUNCTION(BlueprintCallable)    void Clear();
+
+    UFUNCTION()
+    uint8 Evaluate(uint8 current_texture, float time);
+    // Bits without a rule keep their value from current_texture.
+
+    UFUNCTION()
+    bool IsAvailable();
+
+    private:
+    UPROPERTY()
+    TArray<FTextureRule> __rules;
+
+    UPROPERTY()
+    TMap<FName, float> __parameters;    // bool parameters are stored as 0.0 / 1.0
+
+    public:
+    UTextureRuleSet();
+    ~UTextureRuleSet();
+
+};
@@ -0,0 +1,45 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "TransitionPlanCache.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarTransitionPlanCacheSize(
+    TEXT("au.AdaptiveMixer.TransitionPlanCacheSize"),
+    1024,
+    TEXT("Max number of cached texture transition plans per adaptive mixer. 0 = no cache."),
+    ECVF_Default);
+
+void FTransitionPlanCache::Validate(const UAdaptiveScore* score, uint8 filterchain_index, uint32 chain_revision,
+    uint8 valid_stems, const float volumes[PTRN_COUNT]) {
+
+    if ((score == __score) && (filterchain_index == __filterchain_index) && (chain_revision == __chain_revision) &&
+        (valid_stems == __valid_stems) && (FMemory::Memcmp(volumes, __volumes, sizeof(__volumes)) == 0))
+        return;
+
+    __plans.Reset();
+    __score = score;
+    __filterchain_index = filterchain_index;
+    __chain_revision = chain_revision;
+    __valid_stems = valid_stems;
+    FMemory::Memcpy(__volumes, volumes, sizeof(__volumes));
+}
+
+const FTransitionPlan* FTransitionPlanCache::Find(uint8 current, uint8 next) const {
+    return __plans.Find(uint16(current) << 8 | next);
+}
+
+const FTransitionPlan* FTransitionPlanCache::Add(uint8 current, uint8 next, const FTransitionPlan& plan) {
+
+    int32 capacity = CVarTransitionPlanCacheSize.GetValueOnGameThread();
+    if (__plans.Num() >= capacity)
+        __plans.Reset();
+    if (capacity <= 0)
+        return nullptr;
+
+    return &__plans.Add(uint16(current) << 8 | next, plan);
+}
+
+void FTransitionPlanCache::Empty() {
+    __plans.Empty();
+}
@@ -0,0 +1,47 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MixerConstants.h"
+
+class UAdaptiveScore;
+
+// What PlayNewTexture does for one (current, next) texture pair, worked out once.
+struct FTransitionPlan
+{
+    uint8 from_processed;           // filtered current texture
+    uint8 to_processed;             // filtered next texture
+    uint8 wanted;                   // stems audible after the transition
+    uint8 changed;                  // stems whose gain differs between the two
+    float gains[PTRN_COUNT];   // pattern gains after the transition, master not included
+};
+
+// Plans of one mixer, filled lazily. Everything a plan depends on is part of the key,
+// so the cache empties itself when the score, the filter chain or a volume changes.
+// Bounded by au.AdaptiveMixer.TransitionPlanCacheSize; when full it starts over,
+// the pairs a game really uses come back within a few transitions.
+
+class FTransitionPlanCache
+{
+    public:
+
+    void Validate(const UAdaptiveScore* score, uint8 filterchain_index, uint32 chain_revision,
+        uint8 valid_stems, const float volumes[PTRN_COUNT]);
+
+    const FTransitionPlan* Find(uint8 current, uint8 next) const;
+    const FTransitionPlan* Add(uint8 current, uint8 next, const FTransitionPlan& plan);
+
+    void Empty();
+
+    private:
+
+    TMap<uint16, FTransitionPlan> __plans;
+
+    const UAdaptiveScore* __score = nullptr;
+    uint8 __filterchain_index = 0;
+    uint32 __chain_revision = 0;
+    uint8 __valid_stems = 0;
+    float __volumes[PTRN_COUNT] = {};
+};
@@ -0,0 +1,109 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#include "VoiceBudget.h"
+#include "AdaptiveMixer.h"
+#include "AdaptiveMixerStats.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarStemBudget(
+    TEXT("au.AdaptiveMixer.StemBudget"),
+    0,
+    TEXT("Max number of audible pattern stems across all adaptive mixers. 0 = unlimited."),
+    ECVF_Scalability);
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Stems wanted"), STAT_AdaptiveMixerStemsWanted, STATGROUP_AdaptiveMixer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Stems granted"), STAT_AdaptiveMixerStemsGranted, STATGROUP_AdaptiveMixer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Stems over budget"), STAT_AdaptiveMixerStemsDropped, STATGROUP_AdaptiveMixer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Stem budget pressure"), STAT_AdaptiveMixerBudgetPressure, STATGROUP_AdaptiveMixer);
+
+FStemVoiceBudget& FStemVoiceBudget::Get() {
+    static FStemVoiceBudget budget;
+    return budget;
+}
+
+uint8 FStemVoiceBudget::Request(AAdaptiveMixer* mixer, uint8 wanted_mask, const uint8 priorities[PTRN_COUNT]) {
+
+    FStemRequest* r = __requests.FindByPredicate([mixer](const FStemRequest& x) { return x.mixer.Get() == mixer; });
+    if (r == nullptr) {
+        if (wanted_mask == 0)
+            return 0;
+        FStemRequest n;
+        n.mixer = mixer;
+        n.wanted = 0;
+        n.granted = 0;
+        __requests.Add(n);
+        r = &__requests.Last();
+    }
+
+    r->wanted = wanted_mask;
+    FMemory::Memcpy(r->priorities, priorities, PTRN_COUNT);
+    __allocate(mixer);
+    return GetGranted(mixer);
+}
+
+void FStemVoiceBudget::Release(AAdaptiveMixer* mixer) {
+
+    int removed = __requests.RemoveAll([mixer](const FStemRequest& x) { return x.mixer.Get() == mixer; });
+    if (removed > 0)
+        __allocate(nullptr);
+}
+
+uint8 FStemVoiceBudget::GetGranted(const AAdaptiveMixer* mixer) const {
+
+    const FStemRequest* r = __requests.FindByPredicate([mixer](const FStemRequest& x) { return x.mixer.Get() == mixer; });
+    return r ? r->granted : 0;
+}
+
+void FStemVoiceBudget::__allocate(const AAdaptiveMixer* caller) {
+
+    __requests.RemoveAll([](const FStemRequest& x) { return !x.mixer.IsValid(); });
+
+    struct FCandidate
+    {
+        uint8 priority;
+        int request;
+        uint8 stem;
+    };
+
+    TArray<FCandidate> candidates;
+    for (int r = 0; r < __requests.Num(); ++r) {
+        for (int s = 0; s < PTRN_COUNT; ++s) {
+            if (__requests[r].wanted & (1 << s))
+                candidates.Add({ __requests[r].priorities[s], r, uint8(s) });
+        }
+    }
+    // higher priority first; stable, so older mixers and lower pattern indices win ties.
+    candidates.StableSort([](const FCandidate& a, const FCandidate& b) { return a.priority > b.priority; });
+
+    int32 budget = CVarStemBudget.GetValueOnGameThread();
+    int32 granted_count = (budget > 0) ? FMath::Min(budget, candidates.Num()) : candidates.Num();
+
+    TArray<uint8> granted;
+    granted.SetNumZeroed(__requests.Num());
+    for (int i = 0; i < granted_count; ++i) {
+        granted[candidates[i].request] |= 1 << candidates[i].stem;
+    }
+
+    TArray<AAdaptiveMixer*> changed;
+    for (int r = 0; r < __requests.Num(); ++r) {
+        if (granted[r] != __requests[r].granted) {
+            __requests[r].granted = granted[r];
+            if (__requests[r].mixer.Get() != caller)
+                changed.Add(__requests[r].mixer.Get());
+        }
+    }
+
+    SET_DWORD_STAT(STAT_AdaptiveMixerStemsWanted, candidates.Num());
+    SET_DWORD_STAT(STAT_AdaptiveMixerStemsGranted, granted_count);
+    SET_DWORD_STAT(STAT_AdaptiveMixerStemsDropped, candidates.Num() - granted_count);
+    SET_FLOAT_STAT(STAT_AdaptiveMixerBudgetPressure, budget > 0 ? float(candidates.Num()) / budget : 0.0f);
+
+    if (candidates.Num() > granted_count) {
+        UE_LOG(AdaptiveMixerLog, Verbose, TEXT("Stem budget: %d wanted, %d granted."), candidates.Num(), granted_count);
+    }
+
+    for (AAdaptiveMixer* mixer : changed) {
+        mixer->OnVoiceBudgetChanged();
+    }
+}
@@ -0,0 +1,52 @@
+// AleahRise v1.04 -- adaptive soundtrack system for UE4
+// © Daniel Winterreise, 2019
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MixerConstants.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+class AAdaptiveMixer;
+
+// Shared budget of simultaneously audible pattern stems, across all mixers.
+//
+// The budget comes from au.AdaptiveMixer.StemBudget (0 = unlimited). The variable is
+// ECVF_Scalability, so set it per audio quality level in Scalability.ini:
+//
+//     [AudioQuality@0]
+//     au.AdaptiveMixer.StemBudget=6
+//
+// or per platform in its device profile. When more stems are wanted than the budget allows,
+// the lowest-priority ones (UAdaptiveScore::SetPatternPriority) are muted. Give the pattern
+// cues VirtualizationMode = PlayWhenSilent, so muted stems release their voice, keep their
+// playback position and come back in sync when headroom returns.
+
+class FStemVoiceBudget
+{
+    public:
+
+    static FStemVoiceBudget& Get();
+
+    uint8 Request(AAdaptiveMixer* mixer, uint8 wanted_mask, const uint8 priorities[]);
+    // Returns the granted part of wanted_mask. Other mixers whose grant changed
+    // are told through AAdaptiveMixer::OnVoiceBudgetChanged.
+
+    void Release(AAdaptiveMixer* mixer);
+
+    uint8 GetGranted(const AAdaptiveMixer* mixer) const;
+
+    private:
+
+    struct FStemRequest
+    {
+        TWeakObjectPtr<AAdaptiveMixer> mixer;
+        uint8 wanted;
+        uint8 granted;
+        uint8 priorities[PTRN_COUNT];
+    };
+
+    void __allocate(const AAdaptiveMixer* caller);
+
+    TArray<FStemRequest> __requests;    // in request order, older mixers win ties.
+};